@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2023 SANCTUARY Systems GmbH
+#
+# This file is free software: you may copy, redistribute and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation, either version 2 of the License, or (at your
+# option) any later version.
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# For a commercial license, please contact SANCTUARY Systems GmbH
+# directly at info@sanctuary.dev
+
+"""Decodes a dump of the VM-exit trace of a hypervisor built with EXIT_TRACE=y.
+
+The dump is a raw copy of the region whose IPA is returned by
+pg_exit_trace_map(), e.g. taken from the primary VM with
+    dd if=/dev/mem of=trace.bin bs=4096 skip=$((ipa / 4096)) count=<pages>
+The layout is described in inc/vmapi/pg/exit_trace.h.
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+MAGIC = 0x52544550
+VERSION = 1
+
+REASONS = [
+    "wfi",
+    "wfe",
+    "data_abort",
+    "insn_abort",
+    "hvc",
+    "smc",
+    "sysreg",
+    "irq",
+    "other",
+    ]
+LATENCY_BUCKETS = 16
+
+# struct pg_exit_trace_header
+HEADER = struct.Struct("<IIIIIIQQQ")
+# struct pg_exit_record
+RECORD = struct.Struct("<QQQIBBH")
+# head, vm_id and reserved words of struct pg_exit_trace_cpu
+CPU_PREFIX = struct.Struct("<QHHI6Q")
+
+def parse_histogram(data, offset):
+    n = len(REASONS)
+    words = struct.unpack_from("<%dQ" % (2 * n + n * LATENCY_BUCKETS),
+                               data, offset)
+    count = list(words[:n])
+    ticks = list(words[n:2 * n])
+    latency = [list(words[2 * n + r * LATENCY_BUCKETS:
+                          2 * n + (r + 1) * LATENCY_BUCKETS])
+               for r in range(n)]
+    return count, ticks, latency, offset + 8 * len(words)
+
+def describe_exit(rec):
+    entry, exit, ipa, esr, reason, vcpu, vm_id = rec
+    name = REASONS[reason] if reason < len(REASONS) else str(reason)
+    text = "vm %#x vcpu %u %-10s %6u ticks" % (vm_id, vcpu, name,
+                                               exit - entry)
+    if name == "sysreg":
+        # ISS of an MSR/MRS trap
+        op0 = (esr >> 20) & 0x3
+        op2 = (esr >> 17) & 0x7
+        op1 = (esr >> 14) & 0x7
+        crn = (esr >> 10) & 0xf
+        crm = (esr >> 1) & 0xf
+        text += "  %s S%u_%u_C%u_C%u_%u" % ("mrs" if esr & 1 else "msr",
+                                             op0, op1, crn, crm, op2)
+    elif name in ("data_abort", "insn_abort"):
+        text += "  ipa %#x%s" % (ipa, " write" if esr & (1 << 6) else "")
+    elif name != "irq":
+        text += "  esr %#x" % esr
+    return entry, text
+
+def Main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("dump", help="raw copy of the shared trace region")
+    parser.add_argument("--records", type=int, default=32,
+                        help="number of most recent records to print per CPU")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        data = f.read()
+
+    (magic, version, cpu_count, ring_entries, record_size, cpu_size,
+     cpus_offset, size, freq) = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        print("Not an exit trace (magic %#x, version %u)" % (magic, version),
+              file=sys.stderr)
+        return 1
+    if len(data) < size:
+        print("Dump is truncated (%u of %u bytes)" % (len(data), size),
+              file=sys.stderr)
+        return 1
+    if record_size != RECORD.size:
+        print("Unsupported record size %u" % record_size, file=sys.stderr)
+        return 1
+
+    def to_us(ticks):
+        return ticks * 1000000.0 / freq if freq else float("nan")
+
+    per_vm = collections.OrderedDict()
+    recent = []
+    for cpu in range(cpu_count):
+        base = cpus_offset + cpu * cpu_size
+        head, vm_id = CPU_PREFIX.unpack_from(data, base)[:2]
+        count, ticks, latency, offset = parse_histogram(data,
+                                                        base + CPU_PREFIX.size)
+        if head == 0:
+            continue
+
+        vm = per_vm.setdefault(vm_id, ([0] * len(REASONS),
+                                       [0] * len(REASONS),
+                                       [[0] * LATENCY_BUCKETS
+                                        for _ in REASONS]))
+        for r in range(len(REASONS)):
+            vm[0][r] += count[r]
+            vm[1][r] += ticks[r]
+            for b in range(LATENCY_BUCKETS):
+                vm[2][r][b] += latency[r][b]
+
+        first = max(0, head - min(ring_entries, args.records))
+        for i in range(first, head):
+            rec = RECORD.unpack_from(
+                data, offset + (i % ring_entries) * record_size)
+            entry, text = describe_exit(rec)
+            recent.append((entry, "cpu %u  %s" % (cpu, text)))
+
+    for vm_id, (count, ticks, latency) in per_vm.items():
+        print("VM %#x" % vm_id)
+        print("  %-10s %10s %12s %10s  latency log2(ticks) buckets" %
+              ("reason", "exits", "total us", "mean us"))
+        for r, name in enumerate(REASONS):
+            if count[r] == 0:
+                continue
+            print("  %-10s %10u %12.1f %10.2f  %s" %
+                  (name, count[r], to_us(ticks[r]),
+                   to_us(ticks[r]) / count[r],
+                   " ".join(str(n) for n in latency[r])))
+
+    if recent:
+        print("Most recent exits:")
+        for _, text in sorted(recent):
+            print("  " + text)
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(Main())
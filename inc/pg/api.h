@@ -26,12 +26,17 @@ struct vcpu *api_wake_up(struct vcpu *current, struct vcpu *target_vcpu);
 int64_t api_interrupt_enable(uint32_t intid, bool enable,
 			     enum interrupt_type type, struct vcpu *current);
 uint32_t api_interrupt_get(struct vcpu *current);
+int64_t api_interrupt_set_priority(uint32_t intid, uint8_t priority,
+				   struct vcpu *current);
 int64_t api_interrupt_inject(uint16_t target_vm_id,
 			     uint16_t target_vcpu_idx, uint32_t intid,
 			     struct vcpu *current, struct vcpu **next);
 int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 				    uint32_t intid, struct vcpu *current,
 				    struct vcpu **next);
+int64_t api_lock_stats_dump(uint32_t top_n, struct vcpu *current);
+struct ffa_value api_ffa_version(uint32_t requested_version);
+struct ffa_value api_ffa_id_get(const struct vcpu *current);
 
 struct ffa_value api_vm_configure_pages(
 	struct mm_stage1_locked mm_stage1_locked, struct vm_locked vm_locked,
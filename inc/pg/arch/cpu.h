@@ -54,3 +54,15 @@ struct ffa_value arch_regs_get_args(struct arch_regs *regs);
  * Initialize and reset CPU-wide register values.
  */
 void arch_cpu_init(struct cpu *c, ipaddr_t entry_point);
+
+/**
+ * Makes a vCPU that is running on another physical CPU take note of virtual
+ * interrupts that have just been made pending for it, without going through
+ * the scheduler in the primary VM.
+ *
+ * This must be called with the vCPU locked.
+ *
+ * Returns true if the vCPU will see the interrupts without further action,
+ * false if it has to be woken up through the primary VM instead.
+ */
+bool arch_vcpu_kick(struct vcpu_locked vcpu_locked);
@@ -469,8 +469,12 @@ struct interrupt_owner {
 	 * INT_DANGLING -> interrupt activated by VM but not routed to one of its CPUs
 	 */
 	uint8_t status;
+	/* cpu_index() of the physical CPU in GICD_IROUTER<n>, or PCPU_NONE */
+	uint16_t pcpu;
 };
 
+#define PCPU_NONE UINT16_MAX
+
 typedef struct {
     union {
         struct {
@@ -490,10 +494,20 @@ typedef struct {
 
 uint64_t aff_to_no(uint64_t data);
 void reroute_all_interrupts(struct vm* vm, uint32_t cpuid);
-bool access_gicv3(uintreg_t esr, uintreg_t far, uint8_t pc_inc, struct vcpu *vcpu, struct vcpu_fault_info *info);
-bool icc_icv_is_register_access(uintreg_t esr);
+bool register_vgic_mmio(struct vm *vm, uintpaddr_t ipa);
+bool map_vgic_model(struct vm *vm, uintpaddr_t ipa, struct mpool *ppool);
 bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr);
-bool is_cache_maintenance(uintreg_t esr);
+void emulate_sgi1r_write(struct vcpu *vcpu, uint64_t value);
 bool process_cache_maintenance(struct vcpu *vcpu, uintreg_t esr);
 void init_gic();
 void init_vgic(struct vm* vm);
+
+#if EXIT_TRACE
+int64_t vgic_write_stats_dump(struct vcpu *current);
+#else
+static inline int64_t vgic_write_stats_dump(struct vcpu *current)
+{
+	(void)current;
+	return -1;
+}
+#endif
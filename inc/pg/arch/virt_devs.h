@@ -4,6 +4,7 @@
 #include "pg/vcpu.h"            /* vcpu structures         */
 #include "pg/mm.h"              /* mm_stage1_locked        */
 #include "pg/mpool.h"           /* mpool                   */
+#include "pg/mmio.h"            /* mmio_table              */
 
 /* struct virt_dev - virtual device description
  *  @name       : name of virtual device
@@ -28,8 +29,7 @@ struct virt_dev {
 /* public API */
 int init_backing_devs(struct mm_stage1_locked, struct mpool *);
 int init_virt_devs(void);
-bool access_virt_dev(uintreg_t, uintreg_t, uint8_t, struct vcpu *,
-                     struct vcpu_fault_info *);
+int register_virt_devs(struct mmio_table *);
 
 /* used in many virt device driver sources *
  * this is the only common header (so far) */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+/**
+ * Placement of functions in the text of the image (see build/image/image.ld).
+ *
+ * Functions that run on every exit from a VM are marked HOT_TEXT and linked
+ * next to each other and to the EL2 vector table, so that handling an exit
+ * touches as few I-cache lines and TLB entries as possible. Functions that only
+ * run once at boot, on errors or for logging are marked COLD_TEXT and linked
+ * first, at the start of .text, so that they do not sit between the hot code
+ * and the rest of the image.
+ */
+
+#define HOT_TEXT __attribute__((section(".text.hot"), hot))
+#define COLD_TEXT __attribute__((section(".text.unlikely"), cold))
@@ -12,16 +12,29 @@
 
 #if !defined(__ASSEMBLER__)
 
+#include <stdalign.h>
+
 #include "pg/arch/cpu.h"
 
-/* TODO: Fix alignment such that `cpu` structs are in different cache lines. */
+struct vm;
+
+/** Each `cpu` struct occupies its own cache line(s). */
 struct cpu {
 	/** CPU identifier. Doesn't have to be contiguous. */
-	cpu_id_t id;
+	alignas(CACHE_LINE_SIZE) cpu_id_t id;
 
 	/** Pointer to bottom of the stack. */
 	void *stack_bottom;
 
+	/**
+	 * VM the CPU is assigned to and the index of the vCPU it runs in that
+	 * VM. Set once by vm_init() from the manifest's `cpus` list before the
+	 * secondary CPUs are started and never changed afterwards, so they can
+	 * be read without locking. `vm` is NULL if the CPU is unassigned.
+	 */
+	struct vm *vm;
+	uint16_t vcpu_index;
+
 	/** See api.c for the partial ordering on locks. */
 	struct spinlock lock;
 
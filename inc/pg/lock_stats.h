@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Spinlock contention profiling.
+ *
+ * Only compiled in when the hypervisor is built with LOCK_STATS=y. Every
+ * sl_lock() statement owns a static `struct lock_stats_site`; statistics are
+ * accumulated per (site, caller) pair so that locks taken through wrappers
+ * such as vcpu_lock() or vm_lock() are still attributed to the code that
+ * actually asked for them. All times are in system counter (CNTPCT) ticks.
+ */
+
+/** Default number of entries printed by lock_stats_dump(). */
+#define LOCK_STATS_DEFAULT_TOP_N 10
+
+/** Maximum number of distinct (site, caller) pairs that are tracked. */
+#define LOCK_STATS_MAX_ENTRIES 256
+
+/** Static description of an sl_lock() statement. */
+struct lock_stats_site {
+	const char *name;
+	const char *file;
+	uint32_t line;
+};
+
+/** Opaque per-(site, caller) accumulator; see lock_stats.c. */
+struct lock_stats_entry;
+
+struct lock_stats_entry *lock_stats_acquired(
+	const struct lock_stats_site *site, uintptr_t caller, uint64_t spins,
+	uint64_t wait_ticks);
+void lock_stats_released(struct lock_stats_entry *entry, uint64_t hold_ticks);
+void lock_stats_dump(uint32_t top_n);
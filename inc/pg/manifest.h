@@ -258,6 +258,10 @@ struct manifest_vm {
 
 	uint64_t memory_size;
 	bool identity_mapping;
+	bool wfi_idle;
+	bool halt_poll;
+	bool wfx_passthrough;
+	bool vgic_lr;
 	struct vm_mem_layout mem_layout;
 
 	/** NOTE: We add device regions used by FFA secure partitions to all VMs
@@ -335,6 +339,7 @@ enum manifest_return_code {
 	MANIFEST_ERROR_DEVICE_REGION_NODE_EMPTY,
 	MANIFEST_ERROR_RXTX_SIZE_MISMATCH,
 	MANIFEST_ERROR_MALFORMED_UUID,
+	MANIFEST_ERROR_WFX_POLICY_CONFLICT,
 	MANIFEST_ERROR_NO_MEMORY_LAYOUT
 };
 
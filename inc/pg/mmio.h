@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pg/arch/types.h"
+
+/**
+ * Per-VM table of emulated MMIO regions.
+ *
+ * Built while the VM is loaded and never changed afterwards, so the data abort
+ * path searches it without locking. Regions are kept sorted by IPA and never
+ * overlap, so a lookup is a binary search.
+ */
+
+/** Maximum number of emulated MMIO regions per VM. */
+#define MMIO_REGIONS_MAX 32
+
+struct vcpu;
+struct vcpu_fault_info;
+struct mmio_region;
+
+/**
+ * Emulates the access described by `esr`/`info` to `region`. Returns true if
+ * the access was handled and the vCPU may resume, false if the fault must be
+ * handled as a regular page fault.
+ */
+typedef bool (*mmio_access_t)(uintreg_t esr, uintreg_t far, uint8_t pc_inc,
+			      struct vcpu *vcpu, struct vcpu_fault_info *info,
+			      const struct mmio_region *region);
+
+struct mmio_region {
+	/** IPA range [begin, end) handled by `access`. */
+	uintpaddr_t begin;
+	uintpaddr_t end;
+	mmio_access_t access;
+	/** Emulator-specific context, e.g. the device instance. */
+	void *ctx;
+};
+
+struct mmio_table {
+	struct mmio_region regions[MMIO_REGIONS_MAX];
+	size_t count;
+};
+
+bool mmio_region_add(struct mmio_table *table, uintpaddr_t begin,
+		     uintpaddr_t end, mmio_access_t access, void *ctx);
+const struct mmio_region *mmio_region_find(const struct mmio_table *table,
+					   uintpaddr_t ipa);
@@ -41,6 +41,7 @@
 
 #define DEFINE_SIZEOF(sym, type) DEFINE(sym, sizeof(type))
 #define DEFINE_OFFSETOF(sym, type, field) DEFINE(sym, offsetof(type, field))
+#define DEFINE_VALUE(sym, val) DEFINE(sym, val)
 
 #elif defined VERIFY_HEADER
 
@@ -65,6 +66,13 @@
 			      "Generated struct offset mismatch"); \
 	}
 
+#define DEFINE_VALUE(sym, val)                                    \
+	void gen_header__##sym(void)                              \
+	{                                                         \
+		static_assert((val) == (sym),                     \
+			      "Generated constant mismatch");     \
+	}
+
 #else
 #error No action specified
 #endif
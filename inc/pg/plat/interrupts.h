@@ -21,6 +21,8 @@ bool plat_interrupts_controller_driver_init(
 void plat_interrupts_controller_hw_init(struct cpu *c);
 /* ----- */
 void plat_interrupts_set_priority_mask(uint8_t min_priority);
+uint8_t plat_interrupts_get_priority_mask(void);
+uint8_t plat_interrupts_get_running_priority(void);
 /* New: */ 
 void plat_interrupts_set_priority(uint32_t id, uint32_t core_pos,
 				  uint32_t priority);
@@ -30,6 +32,7 @@ void plat_interrupts_set_type(uint32_t id, uint32_t type);
 uint32_t plat_interrupts_get_type(uint32_t id);
 uint32_t plat_interrupts_get_pending_interrupt_id(void);
 void plat_interrupts_end_of_interrupt(uint32_t id);
+void plat_interrupts_deactivate(uint32_t id);
 void plat_interrupts_configure_interrupt(struct interrupt_descriptor int_desc);
 void plat_interrupts_send_sgi(uint32_t id, bool send_to_all,
 			      uint32_t target_list,
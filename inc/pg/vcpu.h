@@ -8,14 +8,39 @@
 
 #pragma once
 
+#include <stdalign.h>
+#include <stdatomic.h>
+
 #include "pg/addr.h"
 #include "pg/spinlock.h"
+#include "pg/static_assert.h"
+#include "pg/std.h"
 
 #include "vmapi/pg/ffa.h"
 
 /** The number of bits in each element of the interrupt bitfields. */
 #define INTERRUPT_REGISTER_BITS 32
 
+/** The number of elements of each interrupt bitfield. */
+#define INTERRUPT_REGISTER_COUNT (PG_NUM_INTIDS / INTERRUPT_REGISTER_BITS)
+
+/**
+ * Virtual interrupt priorities keep as many bits as a GICv3 virtual CPU
+ * interface implements at least, the upper 5 of the 8-bit priority.
+ */
+#define INTERRUPT_PRIORITY_BITS 5
+#define INTERRUPT_PRIORITY_LEVELS (1U << INTERRUPT_PRIORITY_BITS)
+
+static_assert(INTERRUPT_PRIORITY_LEVELS * INTERRUPT_REGISTER_COUNT <= 64,
+	      "Pending summary of virtual interrupts must fit in 64 bits.");
+
+/**
+ * Largest offset of `regs` in `struct vcpu`. exceptions.S saves and restores
+ * the 31 general purpose registers with STP/LDP immediate offsets from
+ * VCPU_REGS, which must stay within the 504 byte reach of the encoding.
+ */
+#define VCPU_REGS_OFFSET_MAX (504 - 8 * 31)
+
 enum vcpu_state {
 	/** The vCPU is switched off. */
 	VCPU_STATE_OFF,
@@ -39,21 +64,50 @@ enum vcpu_state {
 	VCPU_STATE_ABORTED,
 };
 
+/**
+ * Virtual interrupt state of a vCPU.
+ *
+ * Writers hold the vCPU lock so that the counters always match the bitmaps.
+ * The counters and the enabled/pending bitmaps are nevertheless atomic: a
+ * counter is incremented with release semantics only after the corresponding
+ * pending bit has been set, so the return-to-guest path can read the counters
+ * without taking the lock (see vcpu_interrupt_irq_count_read()).
+ */
 struct interrupts {
-	/** Bitfield keeping track of which interrupts are enabled. */
-	uint32_t interrupt_enabled[PG_NUM_INTIDS / INTERRUPT_REGISTER_BITS];
-	/** Bitfield keeping track of which interrupts are pending. */
-	uint32_t interrupt_pending[PG_NUM_INTIDS / INTERRUPT_REGISTER_BITS];
-	/** Bitfield recording the interrupt pin configuration. */
-	uint32_t interrupt_type[PG_NUM_INTIDS / INTERRUPT_REGISTER_BITS];
 	/**
 	 * The number of interrupts which are currently both enabled and
 	 * pending. Count independently virtual IRQ and FIQ interrupt types
 	 * i.e. the sum of the two counters is the number of bits set in
 	 * interrupt_enable & interrupt_pending.
 	 */
-	uint32_t enabled_and_pending_irq_count;
-	uint32_t enabled_and_pending_fiq_count;
+	atomic_uint enabled_and_pending_irq_count;
+	atomic_uint enabled_and_pending_fiq_count;
+	/** Bitfield keeping track of which interrupts are enabled. */
+	atomic_uint interrupt_enabled[INTERRUPT_REGISTER_COUNT];
+	/** Bitfield keeping track of which interrupts are pending. */
+	atomic_uint interrupt_pending[INTERRUPT_REGISTER_COUNT];
+	/**
+	 * Bitfield recording the interrupt pin configuration. Only changed by
+	 * the vCPU itself, under its lock.
+	 */
+	uint32_t interrupt_type[INTERRUPT_REGISTER_COUNT];
+	/**
+	 * Summary of the non-empty words of interrupt_enabled &
+	 * interrupt_pending, split by priority level: bit
+	 * `level * INTERRUPT_REGISTER_COUNT + word` is set while an interrupt
+	 * of that level in that word is enabled and pending, so the lowest set
+	 * bit leads to the highest priority one. Protected by the vCPU lock;
+	 * see vcpu_interrupt_summary_update().
+	 */
+	uint64_t pending_summary;
+	/**
+	 * Priority level of each interrupt, 0 being the highest as on the
+	 * GIC, and the matching bitfields of the interrupts of each level.
+	 * Only changed by the vCPU itself, under its lock.
+	 */
+	uint8_t interrupt_priority[PG_NUM_INTIDS];
+	uint32_t priority_level[INTERRUPT_PRIORITY_LEVELS]
+			       [INTERRUPT_REGISTER_COUNT];
 };
 
 struct vcpu_fault_info {
@@ -63,8 +117,19 @@ struct vcpu_fault_info {
 	uint32_t mode;
 };
 
+/**
+ * The vCPU is split by access pattern into cache-line aligned groups so that
+ * vCPUs of the same VM, which are stored contiguously in `struct vm`, never
+ * share a line:
+ *  - the lock and the state it protects, written by any pCPU that locks it;
+ *  - the register save area, only touched by the pCPU running the vCPU;
+ *  - the virtual interrupt state, written by interrupt injectors.
+ *
+ * NOTE: exceptions.S addresses `regs` with immediate offsets, which limits
+ *       VCPU_REGS to VCPU_REGS_OFFSET_MAX.
+ */
 struct vcpu {
-	struct spinlock lock;
+	alignas(CACHE_LINE_SIZE) struct spinlock lock;
 
 	/*
 	 * The state is only changed in the context of the vCPU being run. This
@@ -73,11 +138,6 @@ struct vcpu {
 	 */
 	enum vcpu_state state;
 
-	struct cpu *cpu;
-	struct vm *vm;
-	struct arch_regs regs;
-	struct interrupts interrupts;
-
 	/*
 	 * Determine whether the 'regs' field is available for use. This is set
 	 * to false when a vCPU is about to run on a physical CPU, and is set
@@ -90,6 +150,13 @@ struct vcpu {
 
 	/* Determine whether partition is currently handling managed exit. */
 	bool processing_managed_exit;
+
+	struct cpu *cpu;
+	struct vm *vm;
+
+	alignas(CACHE_LINE_SIZE) struct arch_regs regs;
+
+	alignas(CACHE_LINE_SIZE) struct interrupts interrupts;
 };
 
 /** Encapsulates a vCPU whose lock is held. */
@@ -116,42 +183,132 @@ bool vcpu_secondary_reset_and_start(struct vcpu_locked vcpu_locked,
 bool vcpu_handle_page_fault(const struct vcpu *current,
 			    struct vcpu_fault_info *f);
 
+void vcpu_interrupt_priority_set(struct vcpu_locked vcpu_locked,
+				 uint32_t intid, uint8_t priority);
+
 void vcpu_reset(struct vcpu *vcpu);
 
 static inline void vcpu_irq_count_increment(struct vcpu_locked vcpu_locked)
 {
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count++;
+	atomic_fetch_add_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count, 1,
+		memory_order_release);
 }
 
 static inline void vcpu_irq_count_decrement(struct vcpu_locked vcpu_locked)
 {
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count--;
+	atomic_fetch_sub_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count, 1,
+		memory_order_release);
 }
 
 static inline void vcpu_fiq_count_increment(struct vcpu_locked vcpu_locked)
 {
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count++;
+	atomic_fetch_add_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count, 1,
+		memory_order_release);
 }
 
 static inline void vcpu_fiq_count_decrement(struct vcpu_locked vcpu_locked)
 {
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count--;
+	atomic_fetch_sub_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count, 1,
+		memory_order_release);
 }
 
 static inline uint32_t vcpu_interrupt_irq_count_get(
 	struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count;
+	return atomic_load_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count,
+		memory_order_relaxed);
 }
 
 static inline uint32_t vcpu_interrupt_fiq_count_get(
 	struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count;
+	return atomic_load_explicit(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count,
+		memory_order_relaxed);
 }
 
 static inline uint32_t vcpu_interrupt_count_get(struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count +
-	       vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count;
+	return vcpu_interrupt_irq_count_get(vcpu_locked) +
+	       vcpu_interrupt_fiq_count_get(vcpu_locked);
+}
+
+/**
+ * Updates the pending summary after the enabled or pending bit of the given
+ * interrupt has changed. The caller must hold the vCPU lock.
+ */
+static inline void vcpu_interrupt_summary_update(
+	struct vcpu_locked vcpu_locked, uint32_t intid)
+{
+	struct interrupts *irqs = &vcpu_locked.vcpu->interrupts;
+	uint32_t index = intid / INTERRUPT_REGISTER_BITS;
+	uint32_t level = irqs->interrupt_priority[intid];
+	uint64_t bit = UINT64_C(1)
+		       << (level * INTERRUPT_REGISTER_COUNT + index);
+
+	if (atomic_load_explicit(&irqs->interrupt_enabled[index],
+				 memory_order_relaxed) &
+	    atomic_load_explicit(&irqs->interrupt_pending[index],
+				 memory_order_relaxed) &
+	    irqs->priority_level[level][index]) {
+		irqs->pending_summary |= bit;
+	} else {
+		irqs->pending_summary &= ~bit;
+	}
+}
+
+/**
+ * Returns the ID of the enabled and pending interrupt of the highest priority,
+ * the lowest ID among those of equal priority, or PG_INVALID_INTID if there is
+ * none. The caller must hold the vCPU lock.
+ */
+static inline uint32_t vcpu_interrupt_next(struct vcpu_locked vcpu_locked)
+{
+	struct interrupts *irqs = &vcpu_locked.vcpu->interrupts;
+	uint32_t first;
+	uint32_t level;
+	uint32_t index;
+	uint32_t bits;
+
+	if (irqs->pending_summary == 0) {
+		return PG_INVALID_INTID;
+	}
+
+	first = __builtin_ctzll(irqs->pending_summary);
+	level = first / INTERRUPT_REGISTER_COUNT;
+	index = first % INTERRUPT_REGISTER_COUNT;
+	bits = atomic_load_explicit(&irqs->interrupt_enabled[index],
+				    memory_order_relaxed) &
+	       atomic_load_explicit(&irqs->interrupt_pending[index],
+				    memory_order_relaxed) &
+	       irqs->priority_level[level][index];
+
+	return index * INTERRUPT_REGISTER_BITS + ctz(bits);
+}
+
+/**
+ * Reads the number of enabled and pending virtual IRQs without holding the
+ * vCPU lock. Pairs with the release in vcpu_irq_count_increment().
+ */
+static inline uint32_t vcpu_interrupt_irq_count_read(struct vcpu *vcpu)
+{
+	return atomic_load_explicit(
+		&vcpu->interrupts.enabled_and_pending_irq_count,
+		memory_order_acquire);
+}
+
+/**
+ * Reads the number of enabled and pending virtual FIQs without holding the
+ * vCPU lock. Pairs with the release in vcpu_fiq_count_increment().
+ */
+static inline uint32_t vcpu_interrupt_fiq_count_read(struct vcpu *vcpu)
+{
+	return atomic_load_explicit(
+		&vcpu->interrupts.enabled_and_pending_fiq_count,
+		memory_order_acquire);
 }
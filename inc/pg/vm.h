@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <stdalign.h>
 #include <stdatomic.h>
 
 #include "pg/arch/types.h"
@@ -16,13 +17,16 @@
 #include "pg/interrupt_desc.h"
 #include "pg/list.h"
 #include "pg/mm.h"
+#include "pg/mmio.h"
 #include "pg/mpool.h"
+#include "pg/seqlock.h"
 #include "pg/string.h"
 #include "vmapi/pg/ffa.h"
 #include "pg/manifest.h"
 
 #define LOG_BUFFER_SIZE 256
 #define VM_MANIFEST_MAX_INTERRUPTS 64
+#define VM_MAX_INTIDS 1024
 
 /**
  * The state of an RX buffer.
@@ -96,18 +100,69 @@ struct mailbox {
 
 struct vm {
 	uint16_t id;
+	ffa_vcpu_count_t vcpu_count;
 	uuid_t uuid;
 	struct smc_whitelist smc_whitelist;
 
-	/** See api.c for the partial ordering on locks. */
-	struct spinlock lock;
-	ffa_vcpu_count_t vcpu_count;
+	/**
+	 * Whether a WFI of a vCPU running on one of the VM's own cores idles
+	 * the core in the hypervisor instead of returning to the primary VM.
+	 * WFI is not trapped by default, so the VM's vCPUs are reset with
+	 * HCR_EL2.TWI set.
+	 */
+	bool wfi_idle;
+
+	/**
+	 * Whether a WFI of the VM's vCPUs is preceded by a short poll for
+	 * wake-ups in the hypervisor (see halt_poll()). Like wfi_idle, this
+	 * sets HCR_EL2.TWI in the VM's vCPUs.
+	 */
+	bool halt_poll;
+
+	/**
+	 * Whether WFI and WFE are executed by the VM's vCPUs without trapping
+	 * to the hypervisor. This is also the default, but the flag rules out
+	 * any per-VM option that would set HCR_EL2.TWI or TWE again. Each vCPU
+	 * owns its physical CPU (see vm_init()) and the VM's interrupts are
+	 * routed to its own CPUs, so the guest idles and wakes up with native
+	 * latency.
+	 */
+	bool wfx_passthrough;
+
+	/**
+	 * Whether virtual interrupts are delivered through the GICv3 list
+	 * registers. The guest then acknowledges and completes them through
+	 * the ICV_* registers without trapping, instead of being signalled
+	 * with HCR_EL2.VI/VF.
+	 */
+	bool vgic_lr;
+
+	/**
+	 * See api.c for the partial ordering on locks. Kept on its own cache
+	 * line so that lock traffic does not evict the read-mostly fields
+	 * above; every vCPU starts on a new cache line as well.
+	 */
+	alignas(CACHE_LINE_SIZE) struct spinlock lock;
 	struct vcpu vcpus[MAX_CPUS];
 	struct mm_ptable ptable;
 	struct mailbox mailbox;
 	char log_buffer[LOG_BUFFER_SIZE];
 	uint16_t log_buffer_length;
 
+	/**
+	 * Placement of the vCPUs on physical cores. Read without taking `lock`
+	 * by the PSCI and interrupt routing paths; see vm_placement_get().
+	 *
+	 * Bit `i` of `vcpus_online` is set while vCPU `i` is powered on, i.e.
+	 * while its interrupts may be routed to `cpus[i]`. `pcpus_online` is
+	 * the same set indexed by cpu_index() of `cpus[i]`, so that a routing
+	 * target can be checked without scanning `cpus`. All three are
+	 * protected by `placement`.
+	 */
+	alignas(CACHE_LINE_SIZE) struct seqlock placement;
+	uint64_t vcpus_online;
+	uint64_t pcpus_online;
+
 	/*
 	 * Stores IDs of physical cores assigned to the VM
 	 */
@@ -144,8 +199,18 @@ struct vm {
 
 	/** Interrupt descriptor */
 	struct interrupt_descriptor interrupt_desc[VM_MANIFEST_MAX_INTERRUPTS];
+
+	/**
+	 * INTIDs routed to the VM, laid out like the GICD_ISENABLER<n>
+	 * registers (bit `i % 32` of word `i / 32` for INTID `i`). Updated
+	 * through vm_intid_owner_set() by the GIC emulator, under its lock.
+	 */
+	uint32_t owned_intids[VM_MAX_INTIDS / 32];
 	struct virt_gic* vgic;
 
+	/** Emulated MMIO regions; built by load_vm(), read-only afterwards. */
+	struct mmio_table mmio;
+
 	/* IPA memory information */
 	ipaddr_t ipa_mem_begin;
 	ipaddr_t ipa_mem_end;
@@ -167,6 +232,11 @@ bool vm_init_next(uint16_t, uint16_t, uint32_t *,
                   struct mpool *, struct vm **);
 
 uint16_t vm_local_cpu_index(struct cpu *);
+uint64_t vm_placement_get(struct vm *vm, cpu_id_t cpus[MAX_CPUS]);
+uint64_t vm_placement_pcpus(struct vm *vm);
+void vm_set_vcpu_online(struct vm *vm, uint16_t vcpu_index, bool online);
+void vm_intid_owner_set(struct vm *old_vm, struct vm *vm, uint32_t intid);
+uint32_t vm_intid_owned_next(const struct vm *vm, uint32_t from);
 
 uint16_t vm_get_count(void);
 struct vm *vm_find(uint16_t id);
@@ -31,6 +31,11 @@
 #define PG_INTERRUPT_ENABLE            0xff03
 #define PG_INTERRUPT_GET               0xff04
 #define PG_INTERRUPT_INJECT            0xff05
+#define PG_LOCK_STATS_DUMP             0xff08
+#define PG_EXIT_TRACE_MAP              0xff09
+#define PG_HALT_POLL_STATS_DUMP        0xff0a
+#define PG_VGIC_WRITE_STATS_DUMP       0xff0c
+#define PG_INTERRUPT_SET_PRIORITY      0xff0d
 
 /* Custom FF-A-like calls returned from FFA_RUN. */
 #define PG_FFA_RUN_WAIT_FOR_INTERRUPT 0xff06
@@ -301,6 +301,20 @@ static inline uint32_t pg_interrupt_get(void)
 	return pg_call(PG_INTERRUPT_GET, 0, 0, 0);
 }
 
+/**
+ * Sets the priority of a given interrupt ID. Lower values are higher
+ * priorities, as on the GIC, and only the upper 5 bits are kept. Pending
+ * interrupts are returned by pg_interrupt_get() highest priority first; all
+ * interrupts start out at priority 0.
+ *
+ * Returns 0 on success, or -1 if the intid is invalid.
+ */
+static inline int64_t pg_interrupt_set_priority(uint32_t intid,
+						uint8_t priority)
+{
+	return pg_call(PG_INTERRUPT_SET_PRIORITY, intid, priority, 0);
+}
+
 /**
  * Injects a virtual interrupt of the given ID into the given target vCPU.
  * This doesn't cause the vCPU to actually be run immediately; it will be taken
@@ -322,6 +336,54 @@ static inline int64_t pg_interrupt_inject(ffa_vm_id_t target_vm_id,
 		       intid);
 }
 
+/**
+ * Prints the `top_n` most contended spinlock sites to the hypervisor log
+ * (0 selects a default). Only available to the primary VM and only if the
+ * hypervisor was built with LOCK_STATS=y.
+ *
+ * Returns 0 on success, or -1 if lock profiling is unavailable.
+ */
+static inline int64_t pg_lock_stats_dump(uint32_t top_n)
+{
+	return pg_call(PG_LOCK_STATS_DUMP, top_n, 0, 0);
+}
+
+/**
+ * Maps the VM-exit trace of the hypervisor read-only into the address space of
+ * the caller. Only available to the primary VM and only if the hypervisor was
+ * built with EXIT_TRACE=y. The layout is described in vmapi/pg/exit_trace.h.
+ *
+ * Returns the IPA of the trace on success, or -1 if it is unavailable.
+ */
+static inline int64_t pg_exit_trace_map(void)
+{
+	return pg_call(PG_EXIT_TRACE_MAP, 0, 0, 0);
+}
+
+/**
+ * Prints the halt-polling counters of all physical CPUs to the hypervisor log.
+ * Only available to the primary VM and only if the hypervisor was built with
+ * HALT_POLL_NS set.
+ *
+ * Returns 0 on success, or -1 if halt polling is unavailable.
+ */
+static inline int64_t pg_halt_poll_stats_dump(void)
+{
+	return pg_call(PG_HALT_POLL_STATS_DUMP, 0, 0, 0);
+}
+
+/**
+ * Prints the number and cost of the GIC writes the hypervisor emulated, and of
+ * its waits for GICD_CTLR.RWP, to the hypervisor log. Only available to the
+ * primary VM and only if the hypervisor was built with EXIT_TRACE=y.
+ *
+ * Returns 0 on success, or -1 if the statistics are unavailable.
+ */
+static inline int64_t pg_vgic_write_stats_dump(void)
+{
+	return pg_call(PG_VGIC_WRITE_STATS_DUMP, 0, 0, 0);
+}
+
 /**
  * Sends a character to the debug log for the VM.
  *
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/types.h"
+
+/**
+ * Layout of the VM-exit trace that the hypervisor shares read-only with the
+ * primary VM when built with EXIT_TRACE=y (see pg_exit_trace_map()).
+ *
+ * The shared region starts with a `struct pg_exit_trace_header`, followed by
+ * one `struct pg_exit_trace_cpu` per physical CPU. All times are in system
+ * counter (CNTPCT) ticks.
+ *
+ * Every per-CPU block has a single writer, the physical CPU it belongs to, so
+ * no atomics are needed to update it. As physical CPUs are statically assigned
+ * to VMs, the histograms of a VM are the sum of those of its CPUs.
+ *
+ * `head` counts the records ever written and is updated after the record it
+ * covers. A reader takes `head`, copies the records in
+ * [head - ring_entries, head) and drops those that may have been overwritten
+ * meanwhile, i.e. the ones below the re-read `head` minus `ring_entries`.
+ */
+
+#define PG_EXIT_TRACE_MAGIC UINT32_C(0x52544550) /* "PETR" */
+#define PG_EXIT_TRACE_VERSION 1
+
+/** Number of records per ring; a power of two. */
+#define PG_EXIT_TRACE_RING_ENTRIES 256
+
+/**
+ * Number of latency buckets per exit reason. Bucket `i` counts exits handled
+ * in [2^(i-1), 2^i) ticks, the last one also everything above.
+ */
+#define PG_EXIT_TRACE_LATENCY_BUCKETS 16
+
+enum pg_exit_reason {
+	PG_EXIT_WFI,
+	PG_EXIT_WFE,
+	PG_EXIT_DATA_ABORT,
+	PG_EXIT_INSN_ABORT,
+	PG_EXIT_HVC,
+	PG_EXIT_SMC,
+	PG_EXIT_SYSREG,
+	PG_EXIT_IRQ,
+	PG_EXIT_OTHER,
+	PG_EXIT_REASON_COUNT,
+};
+
+/** A single exit from a guest into the hypervisor. */
+struct pg_exit_record {
+	/** Counter value when the hypervisor started handling the exit. */
+	uint64_t entry_ticks;
+	/** Counter value when the hypervisor was done with the exit. */
+	uint64_t exit_ticks;
+	/** Faulting IPA for data and instruction aborts, 0 otherwise. */
+	uint64_t ipa;
+	/**
+	 * ESR_EL2 of the exit: EC in bits [31:26], ISS (e.g. the system
+	 * register encoding of an MSR/MRS trap) in bits [24:0]. 0 for IRQs.
+	 */
+	uint32_t esr;
+	/** An `enum pg_exit_reason`. */
+	uint8_t reason;
+	uint8_t vcpu_index;
+	uint16_t vm_id;
+};
+
+/** Cumulative exit statistics, indexed by `enum pg_exit_reason`. */
+struct pg_exit_trace_histogram {
+	uint64_t count[PG_EXIT_REASON_COUNT];
+	/** Total handling time. */
+	uint64_t ticks[PG_EXIT_REASON_COUNT];
+	uint64_t latency[PG_EXIT_REASON_COUNT][PG_EXIT_TRACE_LATENCY_BUCKETS];
+};
+
+/** Trace of one physical CPU. */
+struct pg_exit_trace_cpu {
+	/** Number of records written so far. */
+	uint64_t head;
+	/** VM the CPU is assigned to; 0 until its first exit. */
+	uint16_t vm_id;
+	uint16_t reserved0;
+	uint32_t reserved1;
+	uint64_t reserved2[6];
+	struct pg_exit_trace_histogram histogram;
+	struct pg_exit_record records[PG_EXIT_TRACE_RING_ENTRIES];
+};
+
+struct pg_exit_trace_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t cpu_count;
+	uint32_t ring_entries;
+	uint32_t record_size;
+	/** Size of a `struct pg_exit_trace_cpu`, including padding. */
+	uint32_t cpu_size;
+	/** Offset of the block of the CPU with index 0. */
+	uint64_t cpus_offset;
+	/** Size of the shared region in bytes. */
+	uint64_t size;
+	/** Counter frequency in Hz. */
+	uint64_t counter_freq;
+};
@@ -38,6 +38,7 @@
 #include "pg/check.h"
 #include "pg/dlog.h"
 #include "pg/ffa_internal.h"
+#include "pg/lock_stats.h"
 #include "pg/mm.h"
 #include "pg/plat/console.h"
 #include "pg/plat/interrupts.h"
@@ -86,16 +87,36 @@ static struct vcpu *api_switch_to_vm(struct vcpu *current,
 {
 	struct vm *to_vm = vm_find(to_id);
 	struct vcpu *next = api_get_vm_vcpu(to_vm, current);
+	struct vcpu_locked current_locked;
 
 	CHECK(next != NULL);
 
-	/* Set the return value for the target VM. */
-	arch_regs_set_retval(&next->regs, to_ret);
-
 	/* Set the current vCPU state. */
-	sl_lock(&current->lock);
+	current_locked = vcpu_lock(current);
 	current->state = vcpu_state;
-	sl_unlock(&current->lock);
+
+	/*
+	 * Published under the lock, as vcpu_on() on another CPU may power the
+	 * vCPU on again as soon as it is released.
+	 */
+	if (vcpu_state == VCPU_STATE_OFF) {
+		vm_set_vcpu_online(current->vm, vcpu_index(current), false);
+	}
+
+	/*
+	 * Interrupts injected from another CPU while the vCPU was still
+	 * running only kicked its CPU (see arch_vcpu_kick()), so the primary
+	 * will not be asked to wake it up; have it run the vCPU again instead.
+	 */
+	if (vcpu_state == VCPU_STATE_BLOCKED_INTERRUPT &&
+	    vcpu_interrupt_count_get(current_locked) > 0) {
+		to_ret.func = FFA_INTERRUPT_32;
+		to_ret.arg2 = 0;
+	}
+	vcpu_unlock(&current_locked);
+
+	/* Set the return value for the target VM. */
+	arch_regs_set_retval(&next->regs, to_ret);
 
 	return next;
 }
@@ -253,16 +274,27 @@ int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 	uint32_t intid_index = intid / INTERRUPT_REGISTER_BITS;
 	uint32_t intid_shift = intid % INTERRUPT_REGISTER_BITS;
 	uint32_t intid_mask = 1U << intid_shift;
+	uint32_t pending;
 	int64_t ret = 0;
 
+	/*
+	 * Either way, make it pending. This happens before the count is
+	 * incremented so that a lock-free reader observing the new count also
+	 * observes the pending bit.
+	 */
+	pending = atomic_fetch_or_explicit(
+		&target_vcpu->interrupts.interrupt_pending[intid_index],
+		intid_mask, memory_order_relaxed);
+
 	/*
 	 * We only need to change state and (maybe) trigger a virtual interrupt
 	 * if it is enabled and was not previously pending. Otherwise we can
 	 * skip everything except setting the pending bit.
 	 */
-	if (!(target_vcpu->interrupts.interrupt_enabled[intid_index] &
-	      ~target_vcpu->interrupts.interrupt_pending[intid_index] &
-	      intid_mask)) {
+	if (!(atomic_load_explicit(
+		      &target_vcpu->interrupts.interrupt_enabled[intid_index],
+		      memory_order_relaxed) &
+	      ~pending & intid_mask)) {
 		goto out;
 	}
 
@@ -273,6 +305,7 @@ int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 	} else {
 		vcpu_fiq_count_increment(target_locked);
 	}
+	vcpu_interrupt_summary_update(target_locked, intid);
 
 	/*
 	 * Only need to update state if there was not already an
@@ -282,7 +315,12 @@ int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 		goto out;
 	}
 
-	if (current->vm->id == PG_PRIMARY_VM_ID) {
+	if (current != target_vcpu && arch_vcpu_kick(target_locked)) {
+		/*
+		 * The target vCPU is running on another CPU, which has been
+		 * told to pick up the interrupt directly.
+		 */
+	} else if (current->vm->id == PG_PRIMARY_VM_ID) {
 		/*
 		 * If the call came from the primary VM, let it know that it
 		 * should run or kick the target vCPU.
@@ -293,9 +331,6 @@ int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 	}
 
 out:
-	/* Either way, make it pending. */
-	target_vcpu->interrupts.interrupt_pending[intid_index] |= intid_mask;
-
 	return ret;
 }
 
@@ -516,20 +551,27 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 	uint32_t intid_index = intid / INTERRUPT_REGISTER_BITS;
 	uint32_t intid_shift = intid % INTERRUPT_REGISTER_BITS;
 	uint32_t intid_mask = 1U << intid_shift;
+	uint32_t enabled;
+	uint32_t pending;
 
 	if (intid >= PG_NUM_INTIDS) {
 		return -1;
 	}
 
 	current_locked = vcpu_lock(current);
+	enabled = atomic_load_explicit(
+		&current->interrupts.interrupt_enabled[intid_index],
+		memory_order_relaxed);
+	pending = atomic_load_explicit(
+		&current->interrupts.interrupt_pending[intid_index],
+		memory_order_relaxed);
+
 	if (enable) {
 		/*
 		 * If it is pending and was not enabled before, increment the
 		 * count.
 		 */
-		if (current->interrupts.interrupt_pending[intid_index] &
-		    ~current->interrupts.interrupt_enabled[intid_index] &
-		    intid_mask) {
+		if (pending & ~enabled & intid_mask) {
 			if ((current->interrupts.interrupt_type[intid_index] &
 			     intid_mask) ==
 			    ((uint32_t)INTERRUPT_TYPE_IRQ << intid_shift)) {
@@ -538,8 +580,9 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 				vcpu_fiq_count_increment(current_locked);
 			}
 		}
-		current->interrupts.interrupt_enabled[intid_index] |=
-			intid_mask;
+		atomic_fetch_or_explicit(
+			&current->interrupts.interrupt_enabled[intid_index],
+			intid_mask, memory_order_relaxed);
 
 		if (type == INTERRUPT_TYPE_IRQ) {
 			current->interrupts.interrupt_type[intid_index] &=
@@ -552,9 +595,7 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 		/*
 		 * If it is pending and was enabled before, decrement the count.
 		 */
-		if (current->interrupts.interrupt_pending[intid_index] &
-		    current->interrupts.interrupt_enabled[intid_index] &
-		    intid_mask) {
+		if (pending & enabled & intid_mask) {
 			if ((current->interrupts.interrupt_type[intid_index] &
 			     intid_mask) ==
 			    ((uint32_t)INTERRUPT_TYPE_IRQ << intid_shift)) {
@@ -563,60 +604,83 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 				vcpu_fiq_count_decrement(current_locked);
 			}
 		}
-		current->interrupts.interrupt_enabled[intid_index] &=
-			~intid_mask;
+		atomic_fetch_and_explicit(
+			&current->interrupts.interrupt_enabled[intid_index],
+			~intid_mask, memory_order_relaxed);
 		current->interrupts.interrupt_type[intid_index] &= ~intid_mask;
 	}
+	vcpu_interrupt_summary_update(current_locked, intid);
+
+	vcpu_unlock(&current_locked);
+	return 0;
+}
+
+/**
+ * Sets the priority of a given interrupt ID for the calling vCPU. Pending
+ * interrupts are returned by api_interrupt_get() highest priority (lowest
+ * value) first, and in order of their IDs within the same priority.
+ *
+ * Returns 0 on success, or -1 if the intid is invalid.
+ */
+int64_t api_interrupt_set_priority(uint32_t intid, uint8_t priority,
+				   struct vcpu *current)
+{
+	struct vcpu_locked current_locked;
+
+	if (intid >= PG_NUM_INTIDS) {
+		return -1;
+	}
 
+	current_locked = vcpu_lock(current);
+	vcpu_interrupt_priority_set(current_locked, intid, priority);
 	vcpu_unlock(&current_locked);
+
 	return 0;
 }
 
 /**
- * Returns the ID of the next pending interrupt for the calling vCPU, and
- * acknowledges it (i.e. marks it as no longer pending). Returns
- * PG_INVALID_INTID if there are no pending interrupts.
+ * Returns the ID of the next pending interrupt for the calling vCPU, the one
+ * of the highest priority, and acknowledges it (i.e. marks it as no longer
+ * pending). Returns PG_INVALID_INTID if there are no pending interrupts.
  */
 uint32_t api_interrupt_get(struct vcpu *current)
 {
-	uint8_t i;
-	uint32_t first_interrupt = PG_INVALID_INTID;
+	uint32_t intid;
+	uint32_t intid_index;
+	uint32_t intid_shift;
+	uint32_t intid_mask;
 	struct vcpu_locked current_locked;
 
 	/*
-	 * Find the first enabled and pending interrupt ID, return it, and
-	 * deactivate it.
+	 * Find the enabled and pending interrupt of the highest priority,
+	 * return it, and deactivate it.
 	 */
 	current_locked = vcpu_lock(current);
-	for (i = 0; i < PG_NUM_INTIDS / INTERRUPT_REGISTER_BITS; ++i) {
-		uint32_t enabled_and_pending =
-			current->interrupts.interrupt_enabled[i] &
-			current->interrupts.interrupt_pending[i];
-
-		if (enabled_and_pending != 0) {
-			uint8_t bit_index = ctz(enabled_and_pending);
-			uint32_t intid_mask = 1U << bit_index;
-
-			/*
-			 * Mark it as no longer pending and decrement the count.
-			 */
-			current->interrupts.interrupt_pending[i] &= ~intid_mask;
-
-			if ((current->interrupts.interrupt_type[i] &
-			     intid_mask) == ((uint32_t)INTERRUPT_TYPE_IRQ << bit_index)) {
-				vcpu_irq_count_decrement(current_locked);
-			} else {
-				vcpu_fiq_count_decrement(current_locked);
-			}
+	intid = vcpu_interrupt_next(current_locked);
+	if (intid == PG_INVALID_INTID) {
+		goto out;
+	}
 
-			first_interrupt =
-				i * INTERRUPT_REGISTER_BITS + bit_index;
-			break;
-		}
+	intid_index = intid / INTERRUPT_REGISTER_BITS;
+	intid_shift = intid % INTERRUPT_REGISTER_BITS;
+	intid_mask = 1U << intid_shift;
+
+	/* Mark it as no longer pending and decrement the count. */
+	atomic_fetch_and_explicit(
+		&current->interrupts.interrupt_pending[intid_index],
+		~intid_mask, memory_order_relaxed);
+	vcpu_interrupt_summary_update(current_locked, intid);
+
+	if ((current->interrupts.interrupt_type[intid_index] & intid_mask) ==
+	    ((uint32_t)INTERRUPT_TYPE_IRQ << intid_shift)) {
+		vcpu_irq_count_decrement(current_locked);
+	} else {
+		vcpu_fiq_count_decrement(current_locked);
 	}
 
+out:
 	vcpu_unlock(&current_locked);
-	return first_interrupt;
+	return intid;
 }
 
 /**
@@ -683,3 +747,45 @@ int64_t api_interrupt_inject(uint16_t target_vm_id,
 	return internal_interrupt_inject(target_vcpu, intid, current, next);
 }
 
+/**
+ * Prints the `top_n` most contended spinlock sites to the hypervisor log.
+ *
+ * Returns 0 on success, or -1 if the caller is not the primary VM or the
+ * hypervisor was built without lock profiling.
+ */
+int64_t api_lock_stats_dump(uint32_t top_n, struct vcpu *current)
+{
+	if (current->vm->id != PG_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+#if LOCK_STATS
+	lock_stats_dump(top_n);
+	return 0;
+#else
+	(void)top_n;
+	return -1;
+#endif
+}
+
+/**
+ * Returns the FF-A version implemented by the hypervisor, or
+ * FFA_NOT_SUPPORTED if the caller's version is malformed.
+ */
+struct ffa_value api_ffa_version(uint32_t requested_version)
+{
+	if (requested_version & FFA_VERSION_RESERVED_BIT) {
+		return (struct ffa_value){.func = (uint32_t)FFA_NOT_SUPPORTED};
+	}
+
+	return (struct ffa_value){.func = FFA_VERSION_COMPILED};
+}
+
+/**
+ * Returns the ID of the VM.
+ */
+struct ffa_value api_ffa_id_get(const struct vcpu *current)
+{
+	return (struct ffa_value){.func = FFA_SUCCESS_32,
+				  .arg2 = current->vm->id};
+}
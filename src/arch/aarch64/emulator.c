@@ -20,9 +20,13 @@
 
 #include "pg/arch/emulator.h"
 #include "pg/arch/addr_translator.h"
+#include "pg/code_layout.h"
 #include "msr.h"
 #include "sysregs.h"
+#include "hypervisor/delegated.h"
+#include "hypervisor/vgic_lr.h"
 #include "pg/dlog.h"
+#include "pg/error.h"
 #include "pg/manifest.h"
 
 struct interrupt_owner interrupts[MAX_INTERRUPTS];
@@ -38,22 +42,86 @@ static inline void io_write32(paddr_t addr, uint32_t val)
 	*((uint32_t*)pa_addr(addr)) = val;
 }
 
+#if EXIT_TRACE
+/* cost of trapped GIC writes, protected by `spinlock` */
+static struct {
+	uint64_t traps;         /* emulated writes                      */
+	uint64_t trap_ticks;    /* time spent emulating them            */
+	uint64_t enables;       /* interrupts enabled through ISENABLER */
+	uint64_t elided;        /* writes that left the hardware as is  */
+	uint64_t rwp_waits;     /* waits for GICD_CTLR.RWP              */
+	uint64_t rwp_ticks;     /* time spent in those waits            */
+	uint64_t rwp_coalesced; /* tracked writes sharing a single wait */
+} write_stats;
+
+#define WRITE_STAT(field, n) (write_stats.field += (n))
+
+static inline uint64_t write_stat_now(void)
+{
+	return read_msr(cntpct_el0);
+}
+#else
+#define WRITE_STAT(field, n) ((void)(n))
+
+static inline uint64_t write_stat_now(void)
+{
+	return 0;
+}
+#endif /* EXIT_TRACE */
+
 static void rwp_wait()
 {
 	uint32_t max_wait = 1 << 20; //try 1M times
+	uint64_t start = write_stat_now();
 
+	WRITE_STAT(rwp_waits, 1);
 	while((io_read32(pa_init(FB_GICD_CTLR))) & FB_GICD_CTLR_RWP)
 	{
 		max_wait--;
 		if(!max_wait)
 		{
 			dlog_error("Wait for FB_GICD_CTLR:RWP failed. Continuing anyway...");
-			return;
+			break;
 		}
 	}
+	WRITE_STAT(rwp_ticks, write_stat_now() - start);
+}
+
+/*
+ * Only writes to GICD_CTLR and GICD_ICENABLER<n>(E) are tracked by
+ * GICD_CTLR.RWP, and a guest only learns that they took effect by polling
+ * GICD_CTLR afterwards. Instead of waiting after every trapped write, such
+ * writes are merely recorded here and a single wait is done before the next
+ * access that depends on them (see rwp_sync()). Protected by `spinlock`.
+ */
+static bool rwp_pending = false;
+
+static bool rwp_tracked(uintreg_t addr)
+{
+	return addr == FB_GICD_CTLR
+	    || (addr >= FB_GICD_ICENABLER0 && addr < FB_GICD_ICENABLER0+(32*4))
+	    || (addr >= FB_GICD_ICENABLER0E && addr < FB_GICD_ICENABLER0E+(32*4));
 }
 
-void print_reg_name(uintreg_t addr)
+static void rwp_defer()
+{
+	if(rwp_pending)
+	{
+		WRITE_STAT(rwp_coalesced, 1);
+	}
+	rwp_pending = true;
+}
+
+static void rwp_sync()
+{
+	if(rwp_pending)
+	{
+		rwp_wait();
+		rwp_pending = false;
+	}
+}
+
+COLD_TEXT void print_reg_name(uintreg_t addr)
 {
     uint32_t cpu = 0;
 
@@ -293,25 +361,48 @@ uint32_t no_to_aff(uint32_t cpu_number)
 	return aff2 << 16 | aff1 << 8;
 }
 
+static_assert(VM_MAX_INTIDS == MAX_INTERRUPTS,
+	      "owned_intids does not cover all interrupts");
+
+//record the VM that owns an interrupt in interrupts[] and in the VMs' bitmaps
+static void set_interrupt_owner(uint32_t intid, struct vm* vm)
+{
+	struct vm* old_vm = interrupts[intid].vm;
+
+	if(old_vm == vm)
+	{
+		return;
+	}
+	vm_intid_owner_set(old_vm, vm, intid);
+	interrupts[intid].vm = vm;
+}
+
+//write GICD_IROUTER<n> and remember which physical CPU it targets
+static void set_interrupt_route(uint32_t intid, uint64_t value, struct cpu* target)
+{
+	*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) = value;
+	if(intid < MAX_INTERRUPTS)
+	{
+		interrupts[intid].pcpu = target != NULL ? cpu_index(target) : PCPU_NONE;
+	}
+}
+
 bool routed_to_vm(uint32_t intid, struct vm* vm)
 {
 	// check if interrupt routing is active
-	if(!(*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) & 0x80000000))
+	if(intid >= MAX_INTERRUPTS
+	|| !(*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) & 0x80000000))
 	{
 		return false;
 	}
 
-	// not considering Aff3
-	uint64_t target_id = *((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) & 0x7FFFFFFF;
-
-	for(uint32_t i = 0; i < MAX_CPUS; i++)
+	// target recorded when IROUTER was written, no need to look the CPU up
+	if(interrupts[intid].pcpu == PCPU_NONE)
 	{
-		if(vm->vcpus[i].cpu != NULL && vm->vcpus[i].state != VCPU_STATE_OFF && vm->vcpus[i].cpu->id == target_id)
-		{
-			return true;
-		}
+		return false;
 	}
-	return false;
+
+	return vm_placement_pcpus(vm) & (UINT64_C(1) << interrupts[intid].pcpu);
 }
 
 //reroute an interrupt to another physical CPU of a VM
@@ -324,43 +415,54 @@ void reroute_intid_to_vm(uint32_t intid, uint32_t cpuid)
 {
 	struct vm* vm = NULL;
 	uint32_t cpuid_next = cpuid;
+	cpu_id_t cpus[MAX_CPUS];
+	uint64_t online;
+
 	if(intid < MAX_INTERRUPTS)
 	{
 		vm = interrupts[intid].vm;
 	}
 	if(intid >= 32 && intid <= 988)
 	{
-
+		online = vm_placement_get(vm, cpus);
 		for(int i = 0; i < vm->vcpu_count; i++)
 		{
-			if(vm->vcpus[i].state != VCPU_STATE_OFF && vm->vcpus[i].cpu->id != cpuid)
+			if((online & (UINT64_C(1) << i)) && cpus[i] != cpuid)
 			{
-				cpuid_next = vm->vcpus[i].cpu->id;
+				cpuid_next = cpus[i];
 				break;
 			}
 		}
 
 		if(cpuid_next == cpuid) //haven't found another CPU belonging to the VM
 		{
-			*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) = 0;
-			//TODO: Disable the interrupt or trap them in the hypervisor
+			//disable the interrupt rather than leave it routed to a CPU of
+			//another VM; the VM takes it over again when it re-enables it
+			*((uint32_t*)(FB_GICD_ICENABLER0+(((uint64_t)intid/32)*4))) = 1u << (intid%32);
+			rwp_defer();
+			set_interrupt_owner(intid, NULL);
+			interrupts[intid].pcpu = PCPU_NONE;
 		}
 		else //found a new CPU where the interrupts should be routed to
 		{
-			*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) =  (uint64_t)cpuid_next;
+			set_interrupt_route(intid, (uint64_t)cpuid_next, cpu_find(cpuid_next));
 		}
 	}
 }
 
+//reroute the interrupts owned by a VM away from one of its physical CPUs
+//only the INTIDs set in the VM's owned_intids bitmap are visited
 void reroute_all_interrupts(struct vm* vm, uint32_t cpuid)
 {
-	for(int i = 0; i < MAX_INTERRUPTS; i++)
+	sl_lock(&spinlock);
+	for(uint32_t intid = vm_intid_owned_next(vm, 0); intid < MAX_INTERRUPTS;
+	    intid = vm_intid_owned_next(vm, intid + 1))
 	{
-		if(interrupts[i].vm == vm)
-		{
-			reroute_intid_to_vm(i, cpuid);
-		}
+		reroute_intid_to_vm(intid, cpuid);
 	}
+	//the interrupts disabled above must be off before the CPU goes away
+	rwp_sync();
+	sl_unlock(&spinlock);
 }
 
 //TODO: check that there are not interrupts active or pending before changing the routing
@@ -368,9 +470,10 @@ void reroute_all_interrupts(struct vm* vm, uint32_t cpuid)
 /*
  * intid: ID of the interrupt to be routed
  * cpuid: ID of the physical CPU the interrupt should be routed to
+ * cpu: the physical CPU with ID cpuid
  * vm: pointer to the VM the interrupt should be routed to
  */
-void route_intid_to_cpu(uint32_t intid, uint32_t cpuid, struct vm* vm)
+void route_intid_to_cpu(uint32_t intid, uint32_t cpuid, struct cpu* cpu, struct vm* vm)
 {
 	struct vm* old_vm = NULL;
 	if(intid < MAX_INTERRUPTS)
@@ -380,30 +483,272 @@ void route_intid_to_cpu(uint32_t intid, uint32_t cpuid, struct vm* vm)
 	// first checking if the interrupt ID is one for which routing can be done
 	if(intid >= 32 && intid <= 988)
 	{
-		if(*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) != 0 && vm != old_vm)
+		if(*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) != 0
+		&& old_vm != NULL && vm != old_vm)
 		{
 			reroute_intid_to_vm(intid, cpuid);
 		}
 		else
 		{
-			*((uint64_t*)(FB_GICD_IROUTER0+(((uint64_t)intid)*8))) = (uint64_t)cpuid; // | (0x1 << 31);
+			set_interrupt_route(intid, (uint64_t)cpuid, cpu); // | (0x1 << 31);
 		}
-		rwp_wait();
+		//GICD_IROUTER<n> writes are not tracked by RWP, no need to wait
 	}
 }
 
 
-void write_to_reg(struct vcpu* vcpu, uintreg_t addr, uintreg_t v_addr, uint8_t sas, uint64_t v_value)
+/*
+ * The vGIC backing memory is a software model of the distributor and
+ * redistributor registers as the guest sees them. Most of it is mapped
+ * read-only into the guest (see map_vgic_model()), so it must always hold
+ * what a read would return; writes trap, update the model and only reach the
+ * hardware when they change it.
+ */
+
+/* GICD registers whose value is owned by the hardware: pending and active */
+#define GICD_STATE_BEGIN    FB_GICD_ISPENDR0_OFFSET
+#define GICD_STATE_END      (FB_GICD_ICACTIVER0_OFFSET + 32 * 4)
+#define GICD_STATE_E_BEGIN  FB_GICD_ISPENDR0E_OFFSET
+#define GICD_STATE_E_END    (FB_GICD_ICACTIVER0E_OFFSET + 32 * 4)
+
+/* the same for SGIs and PPIs, in the SGI frame of each redistributor */
+#define GICR_SGI_FRAME      0x10000
+#define GICR_STATE_BEGIN    (GICR_SGI_FRAME + FB_GICR_ISPENDR0_OFFSET)
+#define GICR_STATE_END      (GICR_SGI_FRAME + FB_GICR_ICACTIVER2E_OFFSET + 4)
+
+/* GICR_WAKER bits; ChildrenAsleep follows ProcessorSleep */
+#define GICR_WAKER_PROCESSOR_SLEEP  (1u << 1)
+#define GICR_WAKER_CHILDREN_ASLEEP  (1u << 2)
+
+/* foreign_intids - Collects the interrupts of a bitmap word owned elsewhere
+ *  @vm : VM accessing the distributor
+ *  @n  : word of a GICD bitmap register (INTIDs 32 * n to 32 * n + 31)
+ *
+ *  @return : bits of the interrupts that another VM has enabled
+ */
+static uint32_t
+foreign_intids(const struct vm *vm, uint32_t n)
+{
+    uint32_t bits = 0;  /* answer */
+
+    for (uint32_t i = 0; i < 32 && n * 32 + i < MAX_INTERRUPTS; ++i)
+        if (interrupts[n * 32 + i].vm != NULL
+        &&  interrupts[n * 32 + i].vm != vm)
+            bits |= 1u << i;
+
+    return bits;
+}
+
+/* hw_state_reg - Checks whether a register holds hardware-owned state
+ *  @vm      : VM accessing the register
+ *  @addr    : register address in the physical GIC
+ *  @foreign : [out] bits of the register that belong to other VMs
+ *
+ *  @return : true for the pending and active registers of the distributor
+ *            and of the redistributors; false for anything else
+ *
+ * Extended SPIs are not assigned to VMs, so none of their bits are foreign.
+ */
+static bool
+hw_state_reg(const struct vm *vm, uintreg_t addr, uint32_t *foreign)
+{
+    uintreg_t off;  /* offset in the GIC component */
+
+    *foreign = 0;
+
+    if (addr >= FB_GICD && addr < FB_GICD + FB_GICD_SIZE) {
+        off = (addr - FB_GICD) & ~(uintreg_t) 0x3;
+        if (off >= GICD_STATE_BEGIN && off < GICD_STATE_END) {
+            *foreign = foreign_intids(vm, (off % 0x80) / 4);
+            return true;
+        }
+        return off >= GICD_STATE_E_BEGIN && off < GICD_STATE_E_END;
+    }
+
+#ifdef GICR_ENABLED
+    if (addr >= FB_GICR && addr < FB_GICR + FB_GICR_SIZE) {
+        off = (addr - FB_GICR) % FB_GICR_FRAME_SIZE;
+        return off >= GICR_STATE_BEGIN && off < GICR_STATE_END;
+    }
+#endif /* GICR_ENABLED */
+
+    return false;
+}
+
+/* enable_partner - Locates the other half of a set/clear-enable pair
+ *  @addr : register address in the physical GIC
+ *
+ *  @return : distance in bytes from the register to its partner; positive for
+ *            ISENABLER<n>, negative for ICENABLER<n>, 0 for anything else
+ */
+static int32_t
+enable_partner(uintreg_t addr)
+{
+    uintreg_t off;  /* offset in the GIC component */
+
+    if (addr >= FB_GICD && addr < FB_GICD + FB_GICD_SIZE) {
+        off = addr - FB_GICD;
+        if (off >= FB_GICD_ISENABLER0_OFFSET && off < FB_GICD_ICENABLER0_OFFSET)
+            return 0x80;
+        if (off >= FB_GICD_ICENABLER0_OFFSET && off < FB_GICD_ISPENDR0_OFFSET)
+            return -0x80;
+        if (off >= FB_GICD_ISENABLER0E_OFFSET
+        &&  off <  FB_GICD_ISENABLER0E_OFFSET + 32 * 4)
+            return 0x200;
+        if (off >= FB_GICD_ICENABLER0E_OFFSET
+        &&  off <  FB_GICD_ICENABLER0E_OFFSET + 32 * 4)
+            return -0x200;
+        return 0;
+    }
+
+#ifdef GICR_ENABLED
+    if (addr >= FB_GICR && addr < FB_GICR + FB_GICR_SIZE) {
+        off = (addr - FB_GICR) % FB_GICR_FRAME_SIZE;
+        if (off >= 0x10000 + FB_GICR_ISENABLER0_OFFSET
+        &&  off <= 0x10000 + FB_GICR_ISENABLER2E_OFFSET)
+            return 0x80;
+        if (off >= 0x10000 + FB_GICR_ICENABLER0_OFFSET
+        &&  off <= 0x10000 + FB_GICR_ICENABLER2E_OFFSET)
+            return -0x80;
+    }
+#endif /* GICR_ENABLED */
+
+    return 0;
+}
+
+/* vgic_model_write - Applies a guest write to the vGIC model
+ *  @vm      : VM that performed the write
+ *  @addr    : register address in the physical GIC
+ *  @v_addr  : register address in the model
+ *  @sas     : access size (log2 of the number of bytes)
+ *  @v_value : value written by the guest
+ *  @value   : [in/out] value to write to the hardware
+ *
+ *  @return : true if the hardware must be written; false if it is unaffected
+ *
+ * Set/clear-enable pairs read back the same enable state and only the bits
+ * that change are pushed, so Linux disabling every SPI at boot neither
+ * touches interrupts of other VMs nor waits for GICD_CTLR.RWP. Pending and
+ * active state is left to the hardware and read from there on demand (see
+ * vgic_model_refresh()).
+ */
+static bool
+vgic_model_write(struct vm *vm,
+                 uintreg_t addr,
+                 uintreg_t v_addr,
+                 uint8_t   sas,
+                 uint64_t  v_value,
+                 uint64_t  *value)
+{
+    uint32_t *model = (uint32_t *) v_addr;  /* model of a 32-bit register */
+    uint32_t hw;                            /* hardware enable bits       */
+    uint32_t foreign = 0;                   /* bits of other VMs          */
+    int32_t  partner;                       /* offset of the pair's half  */
+    uintreg_t off;                          /* offset in the distributor  */
+
+    /* components without a model are accessed directly */
+    if (addr == v_addr)
+        return true;
+
+    if (addr == FB_GICD_CTLR) {
+        /* the VM cannot (re)configure the distributor itself */
+        *model = (uint32_t) v_value & ~FB_GICD_CTLR_RWP;
+        return false;
+    }
+
+    if (hw_state_reg(vm, addr, &foreign)) {
+        *value = v_value & ~foreign;
+        return *value != 0;
+    }
+
+    if (sas == 0x2 && addr >= FB_GICD && addr < FB_GICD + FB_GICD_SIZE) {
+        off = addr - FB_GICD;
+        if (off >= FB_GICD_ISENABLER0_OFFSET && off < GICD_STATE_BEGIN)
+            foreign = foreign_intids(vm, (off % 0x80) / 4);
+    }
+
+    partner = sas == 0x2 ? enable_partner(addr) : 0;
+    if (partner > 0) {
+        hw     = *(volatile uint32_t *) addr;
+        *value = v_value & ~hw & ~foreign;
+        *model |= v_value;
+        model[partner / 4] = *model;
+        return *value != 0;
+    }
+    if (partner < 0) {
+        hw     = *(volatile uint32_t *) (addr + partner);
+        *value = v_value & hw & ~foreign;
+        *model &= ~v_value;
+        model[partner / 4] = *model;
+        return *value != 0;
+    }
+
+#ifdef GICR_ENABLED
+    if (sas == 0x2 && addr >= FB_GICR && addr < FB_GICR + FB_GICR_SIZE
+    &&  (addr - FB_GICR) % FB_GICR_FRAME_SIZE == FB_GICR_WAKER_OFFSET) {
+        *model = ((uint32_t) v_value & ~GICR_WAKER_CHILDREN_ASLEEP)
+               | ((v_value & GICR_WAKER_PROCESSOR_SLEEP) << 1);
+        return true;
+    }
+#endif /* GICR_ENABLED */
+
+    switch (sas) {
+    case 0x0:
+        *(uint8_t *) v_addr = v_value;
+        break;
+    case 0x1:
+        *(uint16_t *) v_addr = v_value;
+        break;
+    case 0x2:
+        *(uint32_t *) v_addr = v_value;
+        break;
+    default:
+        *(uint64_t *) v_addr = v_value;
+    }
+
+    return true;
+}
+
+/* vgic_model_refresh - Loads hardware-owned state into the vGIC model
+ *  @vm     : VM about to read the register
+ *  @addr   : register address in the physical GIC
+ *  @v_addr : register address in the model
+ *
+ * The IS/ICPENDR and IS/ICACTIVER registers of the distributor, including the
+ * extended SPI range, and of the redistributors' SGI frames read their state
+ * from the hardware; interrupts of other VMs read as zero.
+ */
+static void
+vgic_model_refresh(struct vm *vm, uintreg_t addr, uintreg_t v_addr)
+{
+    uint32_t foreign;  /* bits of other VMs */
+
+    if (addr == v_addr || !hw_state_reg(vm, addr, &foreign))
+        return;
+
+    *(uint32_t *) (v_addr & ~(uintreg_t) 0x3) =
+        io_read32(pa_init(addr & ~(uintreg_t) 0x3)) & ~foreign;
+}
+
+HOT_TEXT void write_to_reg(struct vcpu* vcpu, uintreg_t addr, uintreg_t v_addr, uint8_t sas, uint64_t v_value)
 {
 	uint64_t value = v_value;
+	uint64_t start = write_stat_now();
+
+	WRITE_STAT(traps, 1);
 	if(addr >= FB_GICD_IROUTER0 && addr <= FB_GICD_IROUTER0E)
 	{
 		uint32_t host_id = 0;
+		struct cpu* host_cpu = NULL;
 		uint32_t target_no = aff_to_no(v_value);
+		uint32_t intid = (addr - FB_GICD_IROUTER0) / 8;
+		cpu_id_t cpus[MAX_CPUS];
+		uint64_t online = vm_placement_get(vcpu->vm, cpus);
 
-		if(target_no < MAX_CPUS && vcpu->vm->vcpus[target_no].cpu != NULL && vcpu->vm->vcpus[target_no].state != VCPU_STATE_OFF)
+		if(target_no < vcpu->vm->vcpu_count && (online & (UINT64_C(1) << target_no)))
 		{
-			host_id = vcpu->vm->vcpus[target_no].cpu->id;
+			host_id = cpus[target_no];
+			host_cpu = cpu_find(host_id);
 		}
 		else
 		{
@@ -412,62 +757,108 @@ void write_to_reg(struct vcpu* vcpu, uintreg_t addr, uintreg_t v_addr, uint8_t s
 			 * that is calling and is active/online.
 			 */
 			host_id = vcpu->cpu->id;
+			host_cpu = vcpu->cpu;
 		}
 		value = (v_value & (1ul << 31)) | host_id;
+
+		if((addr - FB_GICD_IROUTER0) % 8 == 0 && intid < MAX_INTERRUPTS)
+		{
+			interrupts[intid].pcpu = host_cpu != NULL ? cpu_index(host_cpu) : PCPU_NONE;
+		}
 	}
 
 	if(addr == FB_GICD_CTLR)
 	{
-		value = *(uint32_t*)FB_GICD_CTLR; //don't allow VMs to (re)set the GIC
 		v_value = v_value | 0x10; //affinity routing bit is fixed
 	}
 
-	//if GICR_ISENABLER -> update GICR_ICENABLER (and vice versa)
-
-	//TODO: write the v_value to the vGIC and the adjusted value to the real GIC
-	switch(sas)
+	//the model takes v_value, the real GIC only what actually changes
+	if(!vgic_model_write(vcpu->vm, addr, v_addr, sas, v_value, &value))
 	{
-		case 0x0:
-			*((uint8_t*)(addr)) = value; //write to real gic
-			*((uint8_t*)(v_addr)) = v_value; //write to vgic
-			break;
-		case 0x1:
-			*((uint16_t*)(addr)) = value; //write to real gic
-			*((uint16_t*)(v_addr)) = v_value; //write to vgic
-			break;
-		case 0x2:
-			*((uint32_t*)(addr)) = value; //write to real gic
-			*((uint32_t*)(v_addr)) = v_value; //write to vgic
-			break;
-		case 0x3:
-			*((uint64_t*)(addr)) = value; //write to real gic
-			*((uint64_t*)(v_addr)) = v_value; //write to vgic
-			break;
-		default:
-			dlog_error("write to GIC register error");
+		WRITE_STAT(elided, 1);
 	}
+	else
+	{
+		switch(sas)
+		{
+			case 0x0:
+				*((uint8_t*)(addr)) = value; //write to real gic
+				break;
+			case 0x1:
+				*((uint16_t*)(addr)) = value; //write to real gic
+				break;
+			case 0x2:
+				*((uint32_t*)(addr)) = value; //write to real gic
+				break;
+			case 0x3:
+				*((uint64_t*)(addr)) = value; //write to real gic
+				break;
+			default:
+				dlog_error("write to GIC register error");
+		}
 
-	rwp_wait();
+		if(rwp_tracked(addr))
+		{
+			rwp_defer();
+		}
+	}
 
 
 	// when enabling an interrupt the routing is configured to route it to the current physical CPU
 	if(addr >= FB_GICD_ISENABLER0 && addr <= (FB_GICD_ISENABLER0+(31*4)))
 	{
 		uint32_t intid = (addr - FB_GICD_ISENABLER0)*8;
+
+		//interrupts of other VMs are neither rerouted nor taken over
+		v_value &= ~foreign_intids(vcpu->vm, intid / 32);
 		for(uint32_t i = 0; i < 32; i++)
 		{
 			if(v_value & 0x1 && intid+i < MAX_INTERRUPTS)
 			{
 				if(!routed_to_vm(intid+i, vcpu->vm))
 				{
-					route_intid_to_cpu(intid+i, (read_msr(MPIDR_EL1)) & 0x700, vcpu->vm);
+					route_intid_to_cpu(intid+i, (read_msr(MPIDR_EL1)) & 0x700, vcpu->cpu, vcpu->vm);
 				}
-				interrupts[intid+i].vm = vcpu->vm;
+				set_interrupt_owner(intid+i, vcpu->vm);
+				WRITE_STAT(enables, 1);
 			}
 			v_value = v_value >> 1;
 		}
 	}
+
+	WRITE_STAT(trap_ticks, write_stat_now() - start);
+}
+
+#if EXIT_TRACE
+/* vgic_write_stats_dump - Prints the cost of trapped GIC writes
+ *  @current : calling vCPU
+ *
+ *  @return : 0 on success; -1 if the caller is not the primary VM
+ */
+int64_t
+vgic_write_stats_dump(struct vcpu *current)
+{
+    uint64_t freq = read_msr(cntfrq_el0);   /* counter frequency */
+
+    RET(current->vm->id != PG_PRIMARY_VM_ID, -1,
+        "VM %#x may not dump vGIC write statistics\n", current->vm->id);
+
+    sl_lock(&spinlock);
+    dlog("vGIC writes: %u traps, %u ticks (%u ns each), %u interrupts "
+         "enabled\n", write_stats.traps, write_stats.trap_ticks,
+         write_stats.traps && freq
+             ? (write_stats.trap_ticks / write_stats.traps) * 1000000000 / freq
+             : 0,
+         write_stats.enables);
+    dlog("  RWP: %u waits, %u ticks, %u tracked writes coalesced\n",
+         write_stats.rwp_waits, write_stats.rwp_ticks,
+         write_stats.rwp_coalesced);
+    dlog("  %u writes only updated the model\n", write_stats.elided);
+    sl_unlock(&spinlock);
+
+    return 0;
 }
+#endif /* EXIT_TRACE */
 
 
 /* gicr_adjust_cpu_offset - shifts an address into the corresponding GICR frame
@@ -476,7 +867,7 @@ void write_to_reg(struct vcpu* vcpu, uintreg_t addr, uintreg_t v_addr, uint8_t s
  *
  *  @return : the adjusted address
  */
-uintpaddr_t
+HOT_TEXT uintpaddr_t
 gicr_adjust_cpu_offset(uintpaddr_t addr, struct vm* vm)
 {
     /* vCPU number is calculated as number of frames into the GICR (minus 1) *
@@ -505,7 +896,7 @@ gicr_adjust_cpu_offset(uintpaddr_t addr, struct vm* vm)
  *
  *  @return : adjusted address or NULL if outside supported device boundaries
  */
-uintpaddr_t vgic_to_gic(uintpaddr_t ipa, struct vm* vm)
+HOT_TEXT uintpaddr_t vgic_to_gic(uintpaddr_t ipa, struct vm* vm)
 {
     uintpaddr_t corr_ipa;       /* corrected IPA */
 
@@ -537,84 +928,35 @@ uintpaddr_t vgic_to_gic(uintpaddr_t ipa, struct vm* vm)
     return 0;
 }
 
-/**
- * this function manages the access to the GIC. Depending on the VM there
- * are three ways the input address will be read:
- * 1) VM has access to the GIC and the IPA in the info parameter matches the physical GIC address.
- * 2) VM uses a 1-to-1 mapped VGIC where the memory is not mapped to the VM in Stage 2, 
- *    then the VGIC address is also in the IPA of the info field.
- * 3) VM uses a different mapping and has the VGIC mapped in Stage 2 but without write permission,
- *    then the VGIC address can be generated by mapping the virtual address stored in FAR.
+/* emulate_gicv3_access - performs a trapped load/store on the (v)GIC
+ *  @esr       : contents of ESR register (including fault reason)
+ *  @pc_inc    : instruction length
+ *  @vcpu      : vcpu that caused the fault
+ *  @info      : extra information regarding the fault
+ *  @corr_addr : address of the register in the physical GIC
+ *  @vgic_pa   : address of the register in the hypervisor's view
+ *
+ *  @return : true if handled, false otherwise
  */
-bool
-access_gicv3(uintreg_t              esr,
-             uintreg_t              far,
-             uint8_t                pc_inc,
-             struct vcpu            *vcpu,
-             struct vcpu_fault_info *info)
+static HOT_TEXT bool
+emulate_gicv3_access(uintreg_t              esr,
+                     uint8_t                pc_inc,
+                     struct vcpu            *vcpu,
+                     struct vcpu_fault_info *info,
+                     uintpaddr_t            corr_addr,
+                     uintpaddr_t            vgic_pa)
 {
-    bool        ret       = true;   /* function termination status */
-    uintpaddr_t corr_addr = 0;      /* corrected IPA               */
-
-	uintpaddr_t vgic_pa;
-	uintpaddr_t far_pa = pa_addr(arch_translate_va_to_pa(va_init((uintvaddr_t) far), vcpu->vm->ptable));
-
-    /* access to implemented vGIC components */
-    if (info->ipaddr.ipa >= (uintpaddr_t) vcpu->vm->vgic
-    &&  info->ipaddr.ipa <= (uintpaddr_t) vcpu->vm->vgic + sizeof(struct virt_gic))
-    {
-        corr_addr = vgic_to_gic(info->ipaddr.ipa, vcpu->vm);
-		vgic_pa = info->ipaddr.ipa;
-    } else if(far_pa >= (uintpaddr_t)vcpu->vm->vgic && far_pa <= (uintpaddr_t)vcpu->vm->vgic + sizeof(struct virt_gic))
-	{
-		corr_addr = vgic_to_gic(far_pa, vcpu->vm);
-		vgic_pa = far_pa;
-	}
-    /* access to unimplemented vGIC components             *
-     * perform passthrough if components physically exist  *
-     * NOTE: remove these after integrating them into vGIC */
-#ifdef GICC_ENABLED
-    else if (info->ipaddr.ipa >= FB_GICC
-         &&  info->ipaddr.ipa <  FB_GICC + FB_GICC_SIZE)
-    {
-        corr_addr = info->ipaddr.ipa;
-		vgic_pa = info->ipaddr.ipa;
-    }
-#endif /* GICC_ENABLED */
-#ifdef GICV_ENABLED
-    else if (info->ipaddr.ipa >= FB_GICV
-         &&  info->ipaddr.ipa <  FB_GICV + FB_GICV_SIZE)
-    {
-        corr_addr = info->ipaddr.ipa;
-		vgic_pa = info->ipaddr.ipa;
-    }
-#endif /* GICV_ENABLED */
-#ifdef GICH_ENABLED
-    else if (info->ipaddr.ipa >= FB_GICH
-         &&  info->ipaddr.ipa <  FB_GICH + FB_GICH_SIZE)
-    {
-        corr_addr = info->ipaddr.ipa;
-		vgic_pa = info->ipaddr.ipa;
-    }
-#endif /* GICH_ENABLED */
-    /* inject data abort fault into VM to solve it itself */
-    else
-    {
-        ret = true;
-        goto out;
-    }
+    bool ret = true;    /* function termination status */
 
     if(!(esr & 0x1000000)) //Instruction Syndrome Valid (ISV)
     {
-        ret = false;
-        goto out;
+        return false;
     }
 
 	/* if access is not a valid gic field */
 	if (!corr_addr) {
-		dlog_warning("Access is not a valid gic field. ipa:%#x far_pa:%#x\n", info->ipaddr.ipa, far_pa);
-		ret = false;
-		goto out;
+		dlog_warning("Access is not a valid gic field. ipa:%#x pa:%#x\n", info->ipaddr.ipa, vgic_pa);
+		return false;
 	}
 
 	sl_lock(&spinlock);
@@ -622,6 +964,13 @@ access_gicv3(uintreg_t              esr,
 	//https://github.com/ARM-software/arm-trusted-firmware/blob/master/include/drivers/arm/gicv3.h
 	if(info->mode == MM_MODE_R)
 	{
+		//a guest polling GICD_CTLR.RWP must observe its earlier writes completed
+		if(corr_addr == FB_GICD_CTLR)
+		{
+			rwp_sync();
+		}
+		vgic_model_refresh(vcpu->vm, corr_addr, vgic_pa);
+
 		//dlog_debug("VM %x: ESR at read: %#x from %#x (%#x)\n", vcpu->vm, esr, info->ipaddr.ipa, info->vaddr);
 		switch((esr >> 22) & 0x3)
 		{
@@ -717,22 +1066,152 @@ out:
 	return ret;
 }
 
+/* access_vgic - MMIO handler of a VM's vGIC
+ *  @region : vGIC region; ctx is the backing memory of the vGIC
+ *
+ * The vGIC is mapped at a (possibly) different IPA than the address of its
+ * backing memory, without access permissions, so that every access traps.
+ */
+static HOT_TEXT bool
+access_vgic(uintreg_t                esr,
+            uintreg_t                far,
+            uint8_t                  pc_inc,
+            struct vcpu              *vcpu,
+            struct vcpu_fault_info   *info,
+            const struct mmio_region *region)
+{
+    uintpaddr_t vgic_pa;    /* accessed address in the backing memory */
+
+    (void) far;
+
+    vgic_pa = (uintpaddr_t) region->ctx + (info->ipaddr.ipa - region->begin);
+
+    return emulate_gicv3_access(esr, pc_inc, vcpu, info,
+                                vgic_to_gic(vgic_pa, vcpu->vm), vgic_pa);
+}
+
+#if defined(GICC_ENABLED) || defined(GICV_ENABLED) || defined(GICH_ENABLED)
+/* access_gic_passthrough - MMIO handler of unimplemented vGIC components
+ *
+ * Performs the access on the physical component.
+ * NOTE: remove these after integrating them into vGIC
+ */
+static HOT_TEXT bool
+access_gic_passthrough(uintreg_t                esr,
+                       uintreg_t                far,
+                       uint8_t                  pc_inc,
+                       struct vcpu              *vcpu,
+                       struct vcpu_fault_info   *info,
+                       const struct mmio_region *region)
+{
+    (void) far;
+    (void) region;
 
-/**
- * Returns true if the ESR register shows an access to a ICC_* or ICV_*
- * register.
+    return emulate_gicv3_access(esr, pc_inc, vcpu, info,
+                                info->ipaddr.ipa, info->ipaddr.ipa);
+}
+#endif
+
+/* register_vgic_mmio - adds the GIC regions of a VM to its MMIO table
+ *  @vm  : VM in question; vm->vgic must be initialized
+ *  @ipa : IPA at which the vGIC is mapped
+ *
+ *  @return : true if everything went well; false otherwise
+ */
+COLD_TEXT bool
+register_vgic_mmio(struct vm *vm, uintpaddr_t ipa)
+{
+    uintpaddr_t vgic = (uintpaddr_t) vm->vgic;  /* backing memory of vGIC */
+    bool        ans  = true;                    /* answer                 */
+
+    ans &= mmio_region_add(&vm->mmio, ipa, ipa + sizeof(struct virt_gic),
+                           access_vgic, vm->vgic);
+
+    /* VMs that do not map the vGIC at its own address may still access *
+     * it through the address of its backing memory                     */
+    if (vgic != ipa)
+        ans &= mmio_region_add(&vm->mmio, vgic, vgic + sizeof(struct virt_gic),
+                               access_vgic, vm->vgic);
+
+#ifdef GICC_ENABLED
+    ans &= mmio_region_add(&vm->mmio, FB_GICC, FB_GICC + FB_GICC_SIZE,
+                           access_gic_passthrough, NULL);
+#endif /* GICC_ENABLED */
+#ifdef GICV_ENABLED
+    ans &= mmio_region_add(&vm->mmio, FB_GICV, FB_GICV + FB_GICV_SIZE,
+                           access_gic_passthrough, NULL);
+#endif /* GICV_ENABLED */
+#ifdef GICH_ENABLED
+    ans &= mmio_region_add(&vm->mmio, FB_GICH, FB_GICH + FB_GICH_SIZE,
+                           access_gic_passthrough, NULL);
+#endif /* GICH_ENABLED */
+
+    return ans;
+}
+
+/* map_vgic_readable - maps part of the vGIC model read-only into a VM
+ *  @vm    : VM in question
+ *  @ipa   : IPA at which the vGIC is mapped
+ *  @begin : start of the range in the model
+ *  @end   : end of the range in the model (exclusive)
+ *  @ppool : memory pool for the page tables
+ *
+ *  @return : true if everything went well; false otherwise
  */
-bool icc_icv_is_register_access(uintreg_t esr)
+static COLD_TEXT bool
+map_vgic_readable(struct vm   *vm,
+                  uintpaddr_t ipa,
+                  uintpaddr_t begin,
+                  uintpaddr_t end,
+                  struct mpool *ppool)
 {
-	uintreg_t op0 = GET_ISS_OP0(esr);
-	uintreg_t op1 = GET_ISS_OP1(esr);
-	uintreg_t crn = GET_ISS_CRN(esr);
-	uintreg_t crm = GET_ISS_CRM(esr);
+    ipaddr_t at = ipa_init(ipa + (begin - (uintpaddr_t) vm->vgic));
+
+    if (!mm_vm_prepare(&vm->ptable, at, pa_init(begin), pa_init(end - 1),
+                       MM_MODE_R | MM_MODE_D, ppool))
+        return false;
 
-	/* https://developer.arm.com/documentation/ddi0595/2021-06/Index-by-Encoding */
-	return op0 == 0x3 && op1 == 0 && ((crn == 0xC && crm >= 0x8 && crm <= 0xC) || (crn == 0x4 && crm == 0x6));
+    mm_vm_commit(&vm->ptable, at, pa_init(begin), pa_init(end - 1),
+                 MM_MODE_R | MM_MODE_D, ppool, NULL);
+    return true;
 }
 
+/* map_vgic_model - lets a VM read its vGIC model without trapping
+ *  @vm    : VM in question; vm->vgic must be initialized
+ *  @ipa   : IPA at which the vGIC is mapped
+ *  @ppool : memory pool for the page tables
+ *
+ *  @return : true if everything went well; false otherwise
+ *
+ * The vGIC stays mapped without access permissions (every access traps)
+ * except for the distributor past its first two pages and the redistributors
+ * apart from the first page of each SGI frame, which become readable. The
+ * pages that keep trapping hold GICD_CTLR.RWP (see rwp_sync()) and all the
+ * pending and active registers (see vgic_model_refresh()); the ITS keeps
+ * trapping as well.
+ */
+COLD_TEXT bool
+map_vgic_model(struct vm *vm, uintpaddr_t ipa, struct mpool *ppool)
+{
+    uintpaddr_t gicd = (uintpaddr_t) vm->vgic->gicd;  /* model of GICD      */
+    uintpaddr_t gicr;                                 /* model of one GICR  */
+    uintpaddr_t sgi;                                  /* its SGI frame      */
+    bool        ans;                                  /* answer             */
+
+    ans = map_vgic_readable(vm, ipa, gicd + 2 * PAGE_SIZE,
+                            gicd + sizeof(vm->vgic->gicd), ppool);
+
+    for (uint32_t i = 0; i < MAX_FB_GICR && ans; ++i) {
+        gicr = (uintpaddr_t) vm->vgic->gicr[i];
+        sgi  = gicr + GICR_SGI_FRAME;
+
+        ans = map_vgic_readable(vm, ipa, gicr, sgi, ppool)
+           && map_vgic_readable(vm, ipa, sgi + PAGE_SIZE,
+                                gicr + sizeof(vm->vgic->gicr[i]), ppool);
+    }
+
+    return ans;
+}
 
 
 #define ICC_PMR_EL1_ENC 		GET_ISS_ENCODING(0x3, 0x0, 0x4, 0x6, 0x0)
@@ -777,23 +1256,76 @@ bool icc_icv_is_register_access(uintreg_t esr)
 */
 
 
+/* emulate_sgi1r_write - sends a guest SGI to the cores of the target vCPUs
+ *  @vcpu  : vCPU that wrote ICC_SGI1R_EL1
+ *  @value : value written by the guest
+ *
+ * Targets are matched against the MPIDR the guest sees for each of its online
+ * vCPUs (VMPIDR_EL2) and the SGI is sent to their physical cores, with one
+ * write per group of cores that share Aff3.Aff2.Aff1 and RS. Broadcasts
+ * (IRM == 1) only reach the other vCPUs of the same VM, and targets that are
+ * not online vCPUs of the VM are dropped. Since every vCPU has its own core,
+ * the SGI is taken on arrival either by the guest itself or, for VMs using
+ * list registers, by vgic_lr_handle_interrupt(). Such VMs cannot send the
+ * SGI reserved for kicking their cores (VGIC_LR_KICK_SGI).
+ */
+HOT_TEXT void
+emulate_sgi1r_write(struct vcpu *vcpu, uint64_t value)
+{
+    struct vm   *vm = vcpu->vm;     /* VM sending the SGI                  */
+    cpu_id_t    cpus[MAX_CPUS];     /* physical core of each vCPU          */
+    uint64_t    online;             /* online vCPUs of the VM              */
+    uint64_t    vroute;             /* target fields addressing a vCPU     */
+    uint64_t    proute;             /* target fields addressing its core   */
+    uint64_t    batch = 0;          /* SGI1R value being accumulated       */
+    uint16_t    self;               /* index of the sending vCPU           */
+
+    if (vm->vgic_lr
+    &&  (value & ICC_SGI1R_EL1_INTID_MASK)
+            == (uint64_t) VGIC_LR_KICK_SGI << ICC_SGI1R_EL1_INTID_SHIFT)
+        return;
+
+    online = vm_placement_get(vm, cpus);
+    self   = vcpu_index(vcpu);
+
+    for (uint16_t i = 0; i < vm->vcpu_count; ++i) {
+        if (!(online & (UINT64_C(1) << i)))
+            continue;
+
+        if (value & ICC_SGI1R_EL1_IRM) {
+            if (i == self)
+                continue;
+        } else {
+            vroute = icc_sgi1r_route(vm->vcpus[i].regs.lazy.vmpidr_el2);
+            if ((vroute & ICC_SGI1R_EL1_ROUTE_MASK)
+                    != (value & ICC_SGI1R_EL1_ROUTE_MASK)
+            ||  !(vroute & value & ICC_SGI1R_EL1_TARGET_LIST_MASK))
+                continue;
+        }
+
+        /* flush the batch when the next core is in another group */
+        proute = icc_sgi1r_route(cpus[i]);
+        if (batch && (batch & ICC_SGI1R_EL1_ROUTE_MASK)
+                        != (proute & ICC_SGI1R_EL1_ROUTE_MASK)) {
+            write_msr(ICC_SGI1R_EL1, batch);
+            batch = 0;
+        }
+        batch |= proute | (value & ICC_SGI1R_EL1_INTID_MASK);
+    }
+
+    if (batch)
+        write_msr(ICC_SGI1R_EL1, batch);
+}
+
 /**
  * Processes an access (mrs) to a ICC_* or ICV_* register.
  * Returns true if the access was allowed and performed, false otherwise.
  */
-bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
+HOT_TEXT bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
 {
-
-
-	const struct vm *vm = vcpu->vm;
 	uintreg_t sys_register = GET_ISS_SYSREG(esr);
 	uintreg_t rt_register = GET_ISS_RT(esr);
 	uintreg_t value;
-	uintreg_t cpu_no = 0;
-
-    uint32_t aff2;
-    uint32_t aff1;
-    uint32_t aff;
 
 	/* +1 because Rt can access register XZR */
 	CHECK(rt_register < NUM_GP_REGS + 1);
@@ -919,7 +1451,9 @@ bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
 	//		write_msr(ICC_IAR0_EL1, value);
 	//		break;
 		case ICC_EOIR0_EL1_ENC:
-			write_msr(ICC_EOIR0_EL1, value);
+			if (!delegated_interrupt_complete(vcpu, value)) {
+				write_msr(ICC_EOIR0_EL1, value);
+			}
 			break;
 	//	case ICC_HPPIR0_EL1_ENC:
 	//		write_msr(ICC_HPPIR0_EL1, value);
@@ -952,30 +1486,15 @@ bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
 			write_msr(ICC_AP1R3_EL1, value);
 			break;
 		case ICC_DIR_EL1_ENC:
-			write_msr(ICC_DIR_EL1, value);
+			if (!delegated_interrupt_complete(vcpu, value)) {
+				write_msr(ICC_DIR_EL1, value);
+			}
 			break;
 	//	case ICC_RPR_EL1_ENC:
 	//		write_msr(ICC_RPR_EL1, value);
 	//		break;
 		case ICC_SGI1R_EL1_ENC:
-            /* restructure ICC_SGI1R_EL1 Aff{2,1} fields into MPIDR *
-             * format in order for aff_to_no() to work              */
-            aff2 = (value >> 32) & 0xf;
-            aff1 = (value >> 16) & 0xf;
-            aff  = (aff2 << 16) | (aff1 << 8);
-
-			cpu_no = aff_to_no(aff);
-			if(cpu_no < vm->vcpu_count)
-			{
-				uint32_t pcpu = vm->cpus[cpu_no];
-				value = value & 0x81000F000000; //keep all bits that are not affinity-related
-				value |= (pcpu & 0xFF0000) << 16; //Aff2
-				value |= (pcpu & 0xFF00) << 8; //Aff1
-				value |= 0x1; //Aff0 always 1
-			}
-//			dlog_debug("VM%d writing %#016x to ICC_SGI1R_EL1 (Aff3: %02x, Aff2: %02x, Aff1: %02x), Targetlist: %04x\n",
-//					vm->id, value, (value >> 48) & 0xf, (value >> 32) & 0xf, (value >> 16) & 0xf, value & 0xff);
-			write_msr(ICC_SGI1R_EL1, value);
+			emulate_sgi1r_write(vcpu, value);
 			break;
 		case ICC_ASGI1R_EL1_ENC:
 			write_msr(ICC_ASGI1R_EL1, value);
@@ -987,7 +1506,9 @@ bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
 	//		write_msr(ICC_IAR1_EL1, value);
 	//		break;
 		case ICC_EOIR1_EL1_ENC:
-			write_msr(ICC_EOIR1_EL1, value);
+			if (!delegated_interrupt_complete(vcpu, value)) {
+				write_msr(ICC_EOIR1_EL1, value);
+			}
 			break;
 	//	case ICC_HPPIR1_EL1_ENC:
 	//		write_msr(ICC_HPPIR1_EL1, value);
@@ -1030,27 +1551,6 @@ bool icc_icv_process_access(struct vcpu *vcpu, uintreg_t esr)
 	return true;
 }
 
-/**
- * @brief checks if instruction is cache maintenance operation.
- * For now only a subset of Instruction is supported.
- * TODO: This code is only temporary and cache maintenance should be rethought
- * in the future.
- * 
- * @param esr 
- * @return true if it is a cache maintenance operation
- * @return false else
- */
-bool is_cache_maintenance(uintreg_t esr)
-{
-	uintreg_t op0 = GET_ISS_OP0(esr);
-	uintreg_t op1 = GET_ISS_OP1(esr);
-	uintreg_t crn = GET_ISS_CRN(esr);
-	uintreg_t crm = GET_ISS_CRM(esr);
-
-	/* https://developer.arm.com/documentation/ddi0595/2021-06/Index-by-Encoding?lang=en#dc_64 */
-	return op0 == 0x1 && op1 == 0x0 && crn == 0x7 && (crm == 0x6 || crm == 0xA || crm == 0xE);
-}
-
 #define DC_IVAC_ENC			GET_ISS_ENCODING(0x1,0x0,0x7,0x6,0x1)
 #define DC_ISW_ENC			GET_ISS_ENCODING(0x1,0x0,0x7,0x6,0x2)
 #define DC_IGVAC_ENC		GET_ISS_ENCODING(0x1,0x0,0x7,0x6,0x3)
@@ -1127,17 +1627,18 @@ bool process_cache_maintenance(struct vcpu *vcpu, uintreg_t esr)
 	}
 }
 
-void init_interrupt_owners()
+COLD_TEXT void init_interrupt_owners()
 {
 	for(uint32_t i = 0; i < MAX_INTERRUPTS; i++)
 	{
 		interrupts[i].vm = NULL;
 		interrupts[i].status = 0;
+		interrupts[i].pcpu = PCPU_NONE;
 	}
 }
 
 
-void init_gic()
+COLD_TEXT void init_gic()
 {
 	paddr_t gicd_ctlr = pa_init(FB_GICD_CTLR);
 	io_write32(gicd_ctlr, 0); //init FB_GICD_CTLR to zero
@@ -1162,7 +1663,7 @@ void init_gic()
  *
  * TODO: check for values to be set in initial state
  */
-void init_vgic(struct vm* vm)
+COLD_TEXT void init_vgic(struct vm* vm)
 {
 #ifdef GICD_ENABLED
     memset_s(vm->vgic->gicd, sizeof(vm->vgic->gicd), 0, FB_GICD_SIZE);
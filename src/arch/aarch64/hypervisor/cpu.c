@@ -46,6 +46,7 @@
 #include "msr.h"
 #include "perfmon.h"
 #include "sysregs.h"
+#include "vgic_lr.h"
 
 #if BRANCH_PROTECTION
 
@@ -123,6 +124,17 @@ void arch_regs_reset(struct vcpu *vcpu)
 
 //	r->hcr_el2 = get_hcr_el2_value(vm_id);
 	r->hcr_el2 = get_hcr_el2_value(PG_PRIMARY_VM_ID); //TODO: distinguish between full VMs (Linux VMs) and FFA VMs
+
+	/*
+	 * Per-VM WFI/WFE trapping. The value above traps neither WFI nor WFE,
+	 * which is what "wfx_passthrough" VMs get. A WFI must trap for the
+	 * hypervisor to idle the CPU on behalf of the vCPU (see
+	 * wfi_idle_in_el2()) or to poll for its wake-up (see halt_poll()); the
+	 * manifest rejects combining either with pass-through.
+	 */
+	if (vcpu->vm->wfi_idle || vcpu->vm->halt_poll) {
+		r->hcr_el2 |= HCR_EL2_TWI;
+	}
 	r->lazy.cnthctl_el2 = cnthctl;
 	r->lazy.vttbr_el2 = pa_addr(table) | ((uint64_t)vm_id << 48);
 	r->lazy.vmpidr_el2 = vcpu_id;
@@ -149,6 +161,7 @@ void arch_regs_reset(struct vcpu *vcpu)
 
 	//gic_regs_reset(r, is_primary);
 	gic_regs_reset(r, true); //TODO: distinguish between full VMs (Linux VMs) and FFA VMs
+	vgic_lr_regs_reset(vcpu);
 }
 
 void arch_regs_set_pc_arg(struct arch_regs *r, ipaddr_t pc, uintreg_t arg)
@@ -205,3 +218,25 @@ void arch_cpu_init(struct cpu *c, ipaddr_t entry_point)
 
 	plat_interrupts_controller_hw_init(c);
 }
+
+bool arch_vcpu_kick(struct vcpu_locked vcpu_locked)
+{
+	struct vcpu *vcpu = vcpu_locked.vcpu;
+	struct cpu *c = vcpu->cpu;
+
+	/*
+	 * Only a vCPU that is running on the core it owns can be reached
+	 * directly; anything else is up to the scheduler. The state cannot
+	 * change while the vCPU is locked, and a vCPU about to block rechecks
+	 * its interrupts under the same lock (see api_switch_to_vm()).
+	 */
+	if (!vgic_lr_enabled(vcpu) || vcpu->state != VCPU_STATE_RUNNING ||
+	    c == NULL || c->vm != vcpu->vm ||
+	    vm_get_vcpu(c->vm, c->vcpu_index) != vcpu) {
+		return false;
+	}
+
+	vgic_lr_kick(c);
+
+	return true;
+}
@@ -138,18 +138,6 @@
 
 /* clang-format on */
 
-/**
- * Returns true if the ESR register shows an access to an EL1 debug register.
- */
-bool debug_el1_is_register_access(uintreg_t esr)
-{
-	/*
-	 * Architecture Reference Manual D12.2: op0 == 2 is for debug and trace
-	 * system registers, op1 == 1 for trace, remaining are debug.
-	 */
-	return GET_ISS_OP0(esr) == 2 && GET_ISS_OP1(esr) != 1;
-}
-
 /**
  * Processes an access (msr, mrs) to an EL1 debug register.
  * Returns true if the access was allowed and performed, false otherwise.
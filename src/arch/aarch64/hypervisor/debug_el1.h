@@ -14,7 +14,5 @@
 
 #include "vmapi/pg/ffa.h"
 
-bool debug_el1_is_register_access(uintreg_t esr_el2);
-
 bool debug_el1_process_access(struct vcpu *vcpu, uint16_t vm_id,
 			      uintreg_t esr_el2);
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#include "delegated.h"
+
+#include "pg/plat/interrupts.h"
+#include "pg/vm.h"
+
+#include "vgic_lr.h"
+
+/* maximum nesting depth of delegated interrupts on a CPU */
+#define DELEGATED_NEST_MAX 8
+
+/* first shared peripheral interrupt */
+#define DELEGATED_SPI_BASE 32
+
+/* first of the special INTIDs returned on a spurious acknowledge */
+#define DELEGATED_SPECIAL_BASE 1020
+
+/* INTID field of ICC_EOIR<n>_EL1 and ICC_DIR_EL1 */
+#define DELEGATED_INTID_MASK 0xffffff
+
+/*
+ * Interrupts taken on a CPU and delegated to a vCPU of the same CPU that has
+ * not completed them yet, in the order they were taken. Each one is still
+ * active and the priority mask is set to its priority, so priorities strictly
+ * increase towards the top of the stack. Only the owning CPU accesses it.
+ */
+struct delegated_cpu {
+    uint32_t count;          /* number of stacked interrupts              */
+    uint8_t  base_mask;      /* priority mask before the first delegation */
+    struct {
+        uint32_t  id;        /* physical interrupt ID                     */
+        uint8_t   priority;  /* its running priority                      */
+        struct vm *vm;       /* VM that is to complete it                 */
+    } stack[DELEGATED_NEST_MAX];
+};
+
+static struct delegated_cpu delegated_cpus[MAX_CPUS];
+
+/*
+ * SPIs disabled until a vCPU on another CPU completes them, indexed from
+ * DELEGATED_SPI_BASE. Each entry holds the VM the SPI was delegated to, or
+ * NULL if the SPI is not masked.
+ */
+static _Atomic(struct vm *)
+delegated_masked[DELEGATED_SPECIAL_BASE - DELEGATED_SPI_BASE];
+
+/* delegated_interrupt_take - Keeps a delegated interrupt from firing again
+ *                            until the target vCPU has handled it
+ *  @current : vCPU that was interrupted
+ *  @target  : vCPU the interrupt is delegated to
+ *  @id      : acknowledged physical interrupt ID
+ */
+void
+delegated_interrupt_take(struct vcpu *current, struct vcpu *target,
+                         uint32_t id)
+{
+    struct delegated_cpu *d = &delegated_cpus[cpu_index(current->cpu)];
+    uint8_t              priority;  /* running priority of the SPI */
+
+    if (vgic_lr_enabled(target)) {
+        plat_interrupts_end_of_interrupt(id);
+        plat_interrupts_deactivate(id);
+        return;
+    }
+
+    if (target->cpu == current->cpu && d->count < DELEGATED_NEST_MAX) {
+        priority = plat_interrupts_get_running_priority();
+
+        if (d->count == 0)
+            d->base_mask = plat_interrupts_get_priority_mask();
+
+        d->stack[d->count].id       = id;
+        d->stack[d->count].priority = priority;
+        d->stack[d->count].vm       = target->vm;
+        d->count++;
+
+        plat_interrupts_set_priority_mask(priority);
+        return;
+    }
+
+    if (id >= DELEGATED_SPI_BASE && id < DELEGATED_SPECIAL_BASE) {
+        plat_interrupts_disable(id, cpu_index(current->cpu));
+        atomic_store_explicit(&delegated_masked[id - DELEGATED_SPI_BASE],
+                              target->vm, memory_order_relaxed);
+    }
+
+    plat_interrupts_end_of_interrupt(id);
+    plat_interrupts_deactivate(id);
+}
+
+/* delegated_interrupt_complete - Completes a delegated interrupt on behalf of
+ *                                the vCPU that handled it
+ *  @current : vCPU that wrote ICC_EOIR<n>_EL1 or ICC_DIR_EL1
+ *  @id      : value written
+ *
+ *  @return : true if the interrupt was awaiting completion; false if the
+ *            write is to be passed on to the physical CPU interface
+ *
+ * Interrupts stacked on the current CPU are normally completed innermost
+ * first, but an outer one that completes early is removed from the middle.
+ * The priority mask of the next outer interrupt is restored, or the one from
+ * before the first delegation.
+ *
+ * Only the VM an interrupt was delegated to completes it. A write from any
+ * other VM is dropped, so that it neither completes the interrupt nor reaches
+ * the physical CPU interface.
+ */
+bool
+delegated_interrupt_complete(struct vcpu *current, uint32_t id)
+{
+    struct delegated_cpu *d = &delegated_cpus[cpu_index(current->cpu)];
+    struct vm            *vm;   /* VM the SPI was masked for */
+    uint32_t             i;     /* stack position            */
+
+    id &= DELEGATED_INTID_MASK;
+    if (id >= DELEGATED_SPECIAL_BASE)
+        return false;
+
+    for (i = d->count; i > 0; --i)
+        if (d->stack[i - 1].id == id)
+            break;
+
+    if (i > 0) {
+        if (d->stack[i - 1].vm != current->vm)
+            return true;
+
+        for (; i < d->count; ++i)
+            d->stack[i - 1] = d->stack[i];
+        d->count--;
+
+        plat_interrupts_end_of_interrupt(id);
+        plat_interrupts_deactivate(id);
+
+        plat_interrupts_set_priority_mask(
+            d->count == 0 ? d->base_mask : d->stack[d->count - 1].priority);
+        return true;
+    }
+
+    if (id < DELEGATED_SPI_BASE)
+        return false;
+
+    vm = current->vm;
+    if (!atomic_compare_exchange_strong_explicit(
+            &delegated_masked[id - DELEGATED_SPI_BASE], &vm, NULL,
+            memory_order_relaxed, memory_order_relaxed))
+        return vm != NULL;
+
+    plat_interrupts_enable(id, cpu_index(current->cpu));
+    return true;
+}
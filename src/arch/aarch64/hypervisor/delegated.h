@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#pragma once
+
+#include "pg/cpu.h"
+
+/**
+ * Completion of physical interrupts that the hypervisor delegated to a vCPU.
+ *
+ * A delegated interrupt must not fire again before the target vCPU has
+ * handled it. When the target runs on the CPU the interrupt was taken on,
+ * the interrupt stays active and the CPU's priority mask is raised to its
+ * priority, so that only more urgent interrupts preempt the handler.
+ * Otherwise a shared peripheral interrupt is disabled in the distributor,
+ * which any CPU can undo, and completed at once.
+ *
+ * The guest completes the interrupt with the usual write to ICC_EOIR<n>_EL1
+ * or ICC_DIR_EL1, which traps to the hypervisor and is passed on to
+ * delegated_interrupt_complete(), which only honours it from the VM the
+ * interrupt was delegated to. Guests with list registers complete
+ * through the virtual CPU interface without trapping, so interrupts delegated
+ * to them are completed at once, as are SGIs and PPIs delegated to a vCPU on
+ * another CPU.
+ */
+
+void delegated_interrupt_take(struct vcpu *current, struct vcpu *target,
+			      uint32_t id);
+bool delegated_interrupt_complete(struct vcpu *current, uint32_t id);
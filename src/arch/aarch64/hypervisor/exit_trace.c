@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "exit_trace.h"
+
+#if EXIT_TRACE
+
+#include <stdalign.h>
+
+#include "pg/arch/barriers.h"
+#include "pg/arch/init.h"           /* get_ppool                */
+#include "pg/dlog.h"
+#include "pg/error.h"
+#include "pg/mm.h"
+#include "pg/vm.h"
+
+#include "sysregs.h"
+
+/* per-CPU block, padded so that no two CPUs write to the same cache line */
+struct exit_trace_cpu {
+    alignas(CACHE_LINE_SIZE) struct pg_exit_trace_cpu t;
+};
+
+/* everything that is shared with the primary VM */
+struct exit_trace {
+    struct pg_exit_trace_header header;
+    struct exit_trace_cpu       cpus[MAX_CPUS];
+};
+
+#define EXIT_TRACE_SIZE \
+    ((sizeof(struct exit_trace) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+/* padded to whole pages so that mapping it exposes no other hypervisor data */
+static alignas(PAGE_SIZE) union {
+    struct exit_trace trace;
+    uint8_t           pages[EXIT_TRACE_SIZE];
+} shared = {
+    .trace.header = {
+        .magic        = PG_EXIT_TRACE_MAGIC,
+        .version      = PG_EXIT_TRACE_VERSION,
+        .cpu_count    = MAX_CPUS,
+        .ring_entries = PG_EXIT_TRACE_RING_ENTRIES,
+        .record_size  = sizeof(struct pg_exit_record),
+        .cpu_size     = sizeof(struct exit_trace_cpu),
+        .cpus_offset  = offsetof(struct exit_trace, cpus),
+        .size         = EXIT_TRACE_SIZE,
+    },
+};
+
+/* exit_trace_record - Appends an exit to the ring of the current CPU
+ *  @reason      : classification of the exit
+ *  @esr         : syndrome of the exit (0 for IRQs)
+ *  @ipa         : faulting IPA for aborts; 0 otherwise
+ *  @entry_ticks : value returned by exit_trace_enter()
+ *
+ * Must be called before the vCPU is switched, i.e. while TPIDR_EL2 still
+ * refers to the vCPU that caused the exit. EL2 runs with interrupts masked, so
+ * nothing else writes to the block of this CPU in the meantime.
+ */
+static void
+exit_trace_record(enum pg_exit_reason reason,
+                  uint32_t            esr,
+                  uint64_t            ipa,
+                  uint64_t            entry_ticks)
+{
+    struct vcpu               *vcpu;        /* vCPU that caused the exit  */
+    struct pg_exit_trace_cpu  *cpu;         /* trace of the current pCPU  */
+    struct pg_exit_record     *rec;         /* ring slot to fill in       */
+    uint64_t                  exit_ticks;   /* end of exit handling       */
+    uint64_t                  ticks;        /* handling time              */
+    uint64_t                  head;         /* records written so far     */
+    size_t                    bucket;       /* latency histogram bucket   */
+
+    exit_ticks = read_msr(cntpct_el0);
+    ticks      = exit_ticks - entry_ticks;
+
+    vcpu = (struct vcpu *) read_msr(tpidr_el2);
+    cpu  = &shared.trace.cpus[cpu_index(vcpu->cpu)].t;
+
+    /* fill in the slot before publishing the new head */
+    head = cpu->head;
+    rec  = &cpu->records[head & (PG_EXIT_TRACE_RING_ENTRIES - 1)];
+
+    rec->entry_ticks = entry_ticks;
+    rec->exit_ticks  = exit_ticks;
+    rec->ipa         = ipa;
+    rec->esr         = esr;
+    rec->reason      = reason;
+    rec->vcpu_index  = vcpu_index(vcpu);
+    rec->vm_id       = vcpu->vm->id;
+
+    dmb(ishst);
+    *(volatile uint64_t *) &cpu->head = head + 1;
+
+    /* floor(log2(ticks)) + 1, clamped to the last bucket */
+    bucket = ticks ? 64 - __builtin_clzll(ticks) : 0;
+    if (bucket >= PG_EXIT_TRACE_LATENCY_BUCKETS)
+        bucket = PG_EXIT_TRACE_LATENCY_BUCKETS - 1;
+
+    cpu->vm_id = vcpu->vm->id;
+    cpu->histogram.count[reason]++;
+    cpu->histogram.ticks[reason] += ticks;
+    cpu->histogram.latency[reason][bucket]++;
+}
+
+/* exit_trace_sync - Records a synchronous exception from a lower EL
+ *  @esr         : ESR_EL2 of the exception
+ *  @far         : FAR_EL2 of the exception
+ *  @entry_ticks : value returned by exit_trace_enter()
+ */
+void
+exit_trace_sync(uintreg_t esr, uintreg_t far, uint64_t entry_ticks)
+{
+    enum pg_exit_reason reason;     /* classification of the exit  */
+    uint64_t            ipa = 0;    /* faulting IPA (aborts only)  */
+
+    switch (GET_ESR_EC(esr)) {
+    case EC_WFI_WFE:
+        /* TI bit of ISS; 0 = WFI, 1 = WFE */
+        reason = (esr & 1) ? PG_EXIT_WFE : PG_EXIT_WFI;
+        break;
+    case EC_DATA_ABORT_LOWER_EL:
+    case EC_INSTRUCTION_ABORT_LOWER_EL:
+        reason = GET_ESR_EC(esr) == EC_DATA_ABORT_LOWER_EL
+               ? PG_EXIT_DATA_ABORT : PG_EXIT_INSN_ABORT;
+        ipa    = ((read_msr(hpfar_el2) & HPFAR_EL2_FIPA) << 8)
+               | (far & (PAGE_SIZE - 1));
+        break;
+    case EC_HVC:
+        reason = PG_EXIT_HVC;
+        break;
+    case EC_SMC:
+        reason = PG_EXIT_SMC;
+        break;
+    case EC_MSR:
+        reason = PG_EXIT_SYSREG;
+        break;
+    default:
+        reason = PG_EXIT_OTHER;
+        break;
+    }
+
+    exit_trace_record(reason, esr, ipa, entry_ticks);
+}
+
+/* exit_trace_irq - Records an IRQ or FIQ taken from a lower EL
+ *  @entry_ticks : value returned by exit_trace_enter()
+ */
+void
+exit_trace_irq(uint64_t entry_ticks)
+{
+    exit_trace_record(PG_EXIT_IRQ, 0, 0, entry_ticks);
+}
+
+/* exit_trace_map - Maps the trace read-only into the primary VM
+ *  @current : calling vCPU
+ *
+ *  @return : IPA of the trace on success; -1 otherwise
+ *
+ * The trace is identity mapped, so the returned IPA is also its physical
+ * address. Mapping it again is harmless.
+ */
+int64_t
+exit_trace_map(struct vcpu *current)
+{
+    struct vm_locked vm_locked;     /* locked primary VM    */
+    paddr_t          begin;         /* start of the trace   */
+    ipaddr_t         ipa;           /* IPA of the trace     */
+    bool             ans;           /* answer               */
+
+    RET(current->vm->id != PG_PRIMARY_VM_ID, -1,
+        "VM %#x may not map the exit trace\n", current->vm->id);
+
+    shared.trace.header.counter_freq = read_msr(cntfrq_el0);
+
+    begin     = pa_from_va(va_from_ptr(&shared));
+    vm_locked = vm_lock(current->vm);
+    ans       = vm_identity_map(vm_locked, begin,
+                                pa_add(begin, sizeof(shared)),
+                                MM_MODE_R, get_ppool(), &ipa);
+    vm_unlock(&vm_locked);
+    RET(!ans, -1, "Unable to map exit trace into VM %#x\n", current->vm->id);
+
+    return ipa_addr(ipa);
+}
+
+#endif /* EXIT_TRACE */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/arch/types.h"
+
+#include "pg/cpu.h"
+
+#include "vmapi/pg/exit_trace.h"
+
+/**
+ * VM-exit tracing. Only compiled in when the hypervisor is built with
+ * EXIT_TRACE=y; otherwise the hooks below are empty and the exception handlers
+ * are unchanged. The layout of the trace is described in vmapi/pg/exit_trace.h.
+ */
+
+#if EXIT_TRACE
+
+#include "msr.h"
+
+/** Returns the timestamp to pass to the matching exit_trace_*() call. */
+static inline uint64_t exit_trace_enter(void)
+{
+	return read_msr(cntpct_el0);
+}
+
+void exit_trace_sync(uintreg_t esr, uintreg_t far, uint64_t entry_ticks);
+void exit_trace_irq(uint64_t entry_ticks);
+int64_t exit_trace_map(struct vcpu *current);
+
+#else
+
+static inline uint64_t exit_trace_enter(void)
+{
+	return 0;
+}
+
+static inline void exit_trace_sync(uintreg_t esr, uintreg_t far,
+				   uint64_t entry_ticks)
+{
+	(void)esr;
+	(void)far;
+	(void)entry_ticks;
+}
+
+static inline void exit_trace_irq(uint64_t entry_ticks)
+{
+	(void)entry_ticks;
+}
+
+static inline int64_t exit_trace_map(struct vcpu *current)
+{
+	(void)current;
+	return -1;
+}
+
+#endif /* EXIT_TRACE */
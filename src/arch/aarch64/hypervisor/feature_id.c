@@ -69,21 +69,6 @@ enum {
 #undef X
 };
 
-/**
- * Returns true if the ESR register shows an access to a feature ID group 3
- * register.
- */
-bool feature_id_is_register_access(uintreg_t esr)
-{
-	uintreg_t op0 = GET_ISS_OP0(esr);
-	uintreg_t op1 = GET_ISS_OP1(esr);
-	uintreg_t crn = GET_ISS_CRN(esr);
-	uintreg_t crm = GET_ISS_CRM(esr);
-
-	/* From the Arm Architecture Reference Manual Table D12-2. */
-	return op0 == 3 && op1 == 0 && crn == 0 && crm >= 1 && crm <= 7;
-}
-
 /**
  * RAS-related. RES0 when RAS is not implemented.
  */
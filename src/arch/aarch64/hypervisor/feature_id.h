@@ -43,8 +43,6 @@
  */
 #define PG_FEATURE_ALL ((PG_FEATURE_PAUTH << 1) - 1)
 
-bool feature_id_is_register_access(uintreg_t esr_el2);
-
 bool feature_id_process_access(struct vcpu *vcpu, uintreg_t esr_el2);
 
 void feature_set_traps(struct vm *vm, struct arch_regs *regs);
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "fpsimd.h"
+
+#include "pg/arch/barriers.h"
+
+#include "pg/check.h"
+#include "pg/code_layout.h"
+
+#include "msr.h"
+#include "sysregs.h"
+
+/* implemented in exceptions.S */
+void fpsimd_save_state(struct vcpu *vcpu);
+void fpsimd_restore_state(struct vcpu *vcpu);
+
+/* vCPU whose FP/SIMD state is held by the registers of each physical CPU */
+static const struct vcpu *fp_loaded[MAX_CPUS];
+
+/* fpsimd_this_cpu - Finds the physical CPU executing a vCPU
+ *  @vcpu : vCPU running (or about to run) on the caller's CPU
+ *
+ *  @return : ptr to CPU descriptor
+ *
+ * vCPUs are pinned to the core recorded in their `cpu` at boot, so that
+ * descriptor is used after a single comparison with MPIDR_EL1. Only a vCPU run
+ * elsewhere, e.g. by the primary through FFA_RUN, falls back to the search.
+ */
+static struct cpu *
+fpsimd_this_cpu(const struct vcpu *vcpu)
+{
+    struct cpu *c = vcpu->cpu;  /* descriptor of the executing CPU */
+    cpu_id_t   id;              /* affinity of the executing CPU   */
+
+    id = read_msr(mpidr_el1) & MPIDR_EL1_AFFINITY_MASK;
+    if (c != NULL && c->id == id)
+        return c;
+
+    c = cpu_find(id);
+    CHECK(c != NULL);
+
+    return c;
+}
+
+/* fpsimd_set_trap - Enables or disables FP/SIMD access traps on this CPU
+ *  @trap : true to trap accesses from all ELs, false to allow them
+ *
+ * CPTR_EL2 is only written if it changes. The ERET back to the vCPU is
+ * context synchronizing; callers that access the registers themselves must
+ * issue an ISB.
+ */
+static void
+fpsimd_set_trap(bool trap)
+{
+    uintreg_t cptr_el2;  /* value without FP/SIMD trap */
+
+    cptr_el2 = get_cptr_el2_value();
+    if (trap) {
+        if (has_vhe_support())
+            cptr_el2 &= ~CPTR_EL2_VHE_FPEN;
+        else
+            cptr_el2 |= CPTR_EL2_TFP;
+    }
+
+    if (read_msr(CPTR_EL2) != cptr_el2)
+        write_msr(CPTR_EL2, cptr_el2);
+}
+
+/* fpsimd_is_trapped - Checks whether the running vCPU has to trap on FP/SIMD
+ *  @return : true if accesses trap, false if the vCPU may have used them
+ */
+static bool
+fpsimd_is_trapped(void)
+{
+    return read_msr(CPTR_EL2) != get_cptr_el2_value();
+}
+
+/* fpsimd_switch_out - Saves the FP/SIMD state of a vCPU being switched out
+ *  @vcpu : vCPU that stops running on this CPU
+ *
+ * The state is only saved if the vCPU was allowed to access the registers,
+ * i.e. if it may have changed them. The registers keep holding the state, so
+ * the vCPU can resume without a reload if nobody else uses them meanwhile.
+ * Saving here rather than on the next trap keeps the saved copy valid when the
+ * vCPU is later run on a different CPU.
+ */
+HOT_TEXT void
+fpsimd_switch_out(struct vcpu *vcpu)
+{
+    if (fpsimd_is_trapped())
+        return;
+
+    fpsimd_save_state(vcpu);
+}
+
+/* fpsimd_switch_in - Prepares FP/SIMD access for a vCPU being switched in
+ *  @vcpu : vCPU that starts running on this CPU
+ *
+ * Accesses are allowed right away if the registers of this CPU still hold the
+ * vCPU's state, otherwise they trap to fpsimd_access_trap().
+ */
+HOT_TEXT void
+fpsimd_switch_in(struct vcpu *vcpu)
+{
+    struct cpu *c = fpsimd_this_cpu(vcpu);  /* executing CPU */
+
+    fpsimd_set_trap(fp_loaded[cpu_index(c)] != vcpu
+                 || vcpu->regs.fp_cpu != c);
+}
+
+/* fpsimd_access_trap - Handles the first FP/SIMD access of a vCPU
+ *  @vcpu : current vCPU
+ *
+ * Loads the vCPU's state into the registers and disables the trap. The
+ * previous contents were saved when their owner was switched out, so they are
+ * simply overwritten. The trapped instruction is re-executed on return.
+ */
+HOT_TEXT void
+fpsimd_access_trap(struct vcpu *vcpu)
+{
+    struct cpu *c = fpsimd_this_cpu(vcpu);  /* executing CPU */
+
+    fpsimd_set_trap(false);
+    isb();
+
+    if (fp_loaded[cpu_index(c)] != vcpu || vcpu->regs.fp_cpu != c) {
+        fpsimd_restore_state(vcpu);
+        fp_loaded[cpu_index(c)] = vcpu;
+        vcpu->regs.fp_cpu       = c;
+    }
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/cpu.h"
+
+/**
+ * Lazy FP/SIMD context switching. The FP/SIMD registers of a vCPU are only
+ * loaded once it accesses them after being switched in, and only saved if it
+ * was allowed to access them while it ran.
+ */
+
+void fpsimd_switch_out(struct vcpu *vcpu);
+void fpsimd_switch_in(struct vcpu *vcpu);
+void fpsimd_access_trap(struct vcpu *vcpu);
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "halt_poll.h"
+
+#if HALT_POLL_NS
+
+#include <stdalign.h>
+
+#include "pg/arch/timer.h"
+#include "pg/dlog.h"
+#include "pg/error.h"
+#include "pg/vm.h"
+
+#include "msr.h"
+#include "sysregs.h"
+
+/* window a CPU starts with and never shrinks below (in ns) */
+#define HALT_POLL_START_NS \
+    (HALT_POLL_NS < 10000 ? HALT_POLL_NS : 10000)
+
+/* per-CPU poll state, padded so that no two CPUs write to the same line */
+struct halt_poll_cpu {
+    alignas(CACHE_LINE_SIZE) uint64_t window;  /* poll window (ticks)      */
+    uint64_t polls;                            /* halts that were polled   */
+    uint64_t hits;                             /* polls ended by a wake-up */
+    uint64_t poll_ticks;                       /* total time spent polling */
+    uint64_t hit_ticks;                        /* time spent in hits       */
+    uint64_t grown;                            /* window increases         */
+    uint64_t shrunk;                           /* window decreases         */
+};
+
+static struct halt_poll_cpu halt_poll_cpus[MAX_CPUS];
+
+/* halt_poll_ticks - Converts a duration to system counter ticks
+ *  @ns : duration in ns
+ *
+ *  @return : number of ticks
+ */
+static uint64_t
+halt_poll_ticks(uint64_t ns)
+{
+    return (ns * read_msr(cntfrq_el0)) / UINT64_C(1000000000);
+}
+
+/* halt_poll_wake_pending - Checks whether a halted vCPU has to be resumed
+ *  @vcpu : current vCPU
+ *
+ *  @return : true if an interrupt for the vCPU is pending
+ *
+ * The vCPU's timer registers are still live at this point.
+ */
+static bool
+halt_poll_wake_pending(struct vcpu *vcpu)
+{
+    if (vcpu_interrupt_irq_count_read(vcpu) > 0
+    ||  vcpu_interrupt_fiq_count_read(vcpu) > 0)
+        return true;
+
+    if (arch_timer_enabled_current()
+    &&  arch_timer_remaining_ns_current() == 0)
+        return true;
+
+    /* physical interrupt, masked while in EL2 */
+    return (read_msr(isr_el1) & (ISR_EL1_I | ISR_EL1_F)) != 0;
+}
+
+/* halt_poll - Polls for a wake-up of a vCPU that executed WFI
+ *  @vcpu : current vCPU
+ *
+ *  @return : true if the vCPU is to be resumed; false if it has to block
+ *
+ * A wake-up in the second half of the window suggests the window is too short
+ * and doubles it, up to HALT_POLL_NS. A poll without wake-up halves it, down to
+ * HALT_POLL_START_NS.
+ */
+bool
+halt_poll(struct vcpu *vcpu)
+{
+    struct halt_poll_cpu *c;        /* state of the current pCPU */
+    uint64_t             start;     /* beginning of the poll     */
+    uint64_t             elapsed;   /* time polled so far        */
+
+    if (!vcpu->vm->halt_poll)
+        return false;
+
+    c = &halt_poll_cpus[cpu_index(vcpu->cpu)];
+    if (!c->window)
+        c->window = halt_poll_ticks(HALT_POLL_START_NS);
+
+    c->polls++;
+    start = read_msr(cntpct_el0);
+
+    do {
+        elapsed = read_msr(cntpct_el0) - start;
+
+        if (halt_poll_wake_pending(vcpu)) {
+            c->hits++;
+            c->hit_ticks  += elapsed;
+            c->poll_ticks += elapsed;
+
+            if (elapsed > c->window / 2
+            &&  c->window < halt_poll_ticks(HALT_POLL_NS)) {
+                c->window *= 2;
+                if (c->window > halt_poll_ticks(HALT_POLL_NS))
+                    c->window = halt_poll_ticks(HALT_POLL_NS);
+                c->grown++;
+            }
+
+            return true;
+        }
+
+        __asm__ volatile("yield");
+    } while (elapsed < c->window);
+
+    c->poll_ticks += elapsed;
+
+    if (c->window > halt_poll_ticks(HALT_POLL_START_NS)) {
+        c->window /= 2;
+        if (c->window < halt_poll_ticks(HALT_POLL_START_NS))
+            c->window = halt_poll_ticks(HALT_POLL_START_NS);
+        c->shrunk++;
+    }
+
+    return false;
+}
+
+/* halt_poll_stats_dump - Prints the poll counters of all CPUs
+ *  @current : calling vCPU
+ *
+ *  @return : 0 on success; -1 if the caller is not the primary VM
+ *
+ * The counters are read without synchronization and are only approximate
+ * while other CPUs are polling.
+ */
+int64_t
+halt_poll_stats_dump(struct vcpu *current)
+{
+    struct halt_poll_cpu *c;        /* state of the reported pCPU */
+
+    RET(current->vm->id != PG_PRIMARY_VM_ID, -1,
+        "VM %#x may not dump halt-poll statistics\n", current->vm->id);
+
+    dlog("halt poll: max window %u ns, counter frequency %u Hz\n",
+         (uint64_t) HALT_POLL_NS, read_msr(cntfrq_el0));
+
+    for (size_t i = 0; i < MAX_CPUS; ++i) {
+        c = &halt_poll_cpus[i];
+        if (!c->polls)
+            continue;
+
+        dlog("  cpu %u: polls %u hits %u (%u%%) poll ticks %u hit ticks %u "
+             "window %u ticks (grown %u, shrunk %u)\n",
+             i, c->polls, c->hits, (c->hits * 100) / c->polls,
+             c->poll_ticks, c->hit_ticks, c->window, c->grown, c->shrunk);
+    }
+
+    return 0;
+}
+
+#endif /* HALT_POLL_NS */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/cpu.h"
+
+/**
+ * Adaptive halt polling. Only compiled in when the hypervisor is built with
+ * HALT_POLL_NS=<max window>; otherwise a blocked vCPU gives up its physical
+ * CPU right away. Polling is enabled per VM with the "wfi_halt_poll" manifest
+ * property, which also makes the VM's WFIs trap.
+ *
+ * Before a vCPU that executed WFI is switched out, the CPU spins for the
+ * current poll window waiting for a virtual interrupt, the vCPU's timer or a
+ * physical interrupt. The window of each CPU grows when wake-ups arrive late
+ * in the window and shrinks when they do not arrive at all.
+ */
+
+#if HALT_POLL_NS
+
+bool halt_poll(struct vcpu *vcpu);
+int64_t halt_poll_stats_dump(struct vcpu *current);
+
+#else
+
+static inline bool halt_poll(struct vcpu *vcpu)
+{
+	(void)vcpu;
+	return false;
+}
+
+static inline int64_t halt_poll_stats_dump(struct vcpu *current)
+{
+	(void)current;
+	return -1;
+}
+
+#endif /* HALT_POLL_NS */
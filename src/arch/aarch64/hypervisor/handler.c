@@ -34,12 +34,11 @@
 #include "pg/arch/mmu.h"
 #include "pg/arch/plat/smc.h"
 #include "pg/arch/tee/mediator.h"
-#include "pg/arch/virtioac.h"
 #include "pg/arch/emulator.h"
-#include "pg/arch/virt_devs.h"
 
 #include "pg/api.h"
 #include "pg/check.h"
+#include "pg/code_layout.h"
 #include "pg/cpu.h"
 #include "pg/dlog.h"
 #include "pg/ffa.h"
@@ -52,23 +51,18 @@
 #include "vmapi/pg/call.h"
 
 #include "debug_el1.h"
+#include "delegated.h"
+#include "exit_trace.h"
 #include "feature_id.h"
+#include "fpsimd.h"
+#include "halt_poll.h"
 #include "msr.h"
 #include "perfmon.h"
 #include "psci.h"
 #include "psci_handler.h"
 #include "smc.h"
 #include "sysregs.h"
-
-/**
- * Hypervisor Fault Address Register Non-Secure.
- */
-#define HPFAR_EL2_NS (UINT64_C(0x1) << 63)
-
-/**
- * Hypervisor Fault Address Register Faulting IPA.
- */
-#define HPFAR_EL2_FIPA (UINT64_C(0xFFFFFFFFFF0))
+#include "vgic_lr.h"
 
 /**
  * Gets the value to increment for the next PC.
@@ -95,8 +89,8 @@ static struct vcpu *current(void)
  * returns the vCPU by the interrupt owning VM targeted
  * by the interrupt.
  */
-static struct vcpu *find_target_vcpu(struct vcpu *current,
-					      uint32_t interrupt_id)
+static HOT_TEXT struct vcpu *find_target_vcpu(struct vcpu *current,
+					       uint32_t interrupt_id)
 {
 	bool target_vm_found = false;
 	struct vm *vm;
@@ -137,6 +131,9 @@ static struct vcpu *find_target_vcpu(struct vcpu *current,
 	return target_vcpu;
 }
 
+/** First of the special INTIDs returned on a spurious acknowledge. */
+#define SPURIOUS_INTID_BASE 1020
+
 /**
  * NOTE: this is from WIP Hafnium upstream
  * 
@@ -157,7 +154,8 @@ static struct vcpu *find_target_vcpu(struct vcpu *current,
 /**
  * Delegate the interrupt handling to the target vcpu.
  */
-static void delegate_interrupt(struct vcpu *current, struct vcpu **next)
+static HOT_TEXT void delegate_interrupt(struct vcpu *current,
+				       struct vcpu **next)
 {
 	int64_t ret;
 	uint32_t id;
@@ -168,6 +166,20 @@ static void delegate_interrupt(struct vcpu *current, struct vcpu **next)
 	/* Find pending interrupt id. This also activates the interrupt. */
 	id = plat_interrupts_get_pending_interrupt_id();
 
+	/*
+	 * vCPUs with list registers take their interrupts directly; the guest
+	 * acknowledges the virtual copy, so nothing needs to be masked.
+	 */
+	if (vgic_lr_enabled(current) && vgic_lr_handle_interrupt(current, id)) {
+		*next = NULL;
+		return;
+	}
+
+	if (id >= SPURIOUS_INTID_BASE) {
+		*next = NULL;
+		return;
+	}
+
 	target_vcpu = find_target_vcpu(current, id);
 
 	/* Update the state of current vCPU. */
@@ -175,14 +187,8 @@ static void delegate_interrupt(struct vcpu *current, struct vcpu **next)
 	current->state = VCPU_STATE_PREEMPTED;
 	vcpu_unlock(&current_vcpu_locked);
 
-	/**
-	 *  TODO: set priority mask back after interrupt 
-	 * was handled with plat_interrupts_set_priority_mask(0xff);
-	 * 
-	 *	TODO: Temporarily mask all interrupts to disallow high priority
-	 * interrupts from pre-empting current interrupt processing.
-	 */
-	plat_interrupts_set_priority_mask(0x0);
+	/* Hold the interrupt back until the target vCPU completes it. */
+	delegated_interrupt_take(current, target_vcpu, id);
 
 	target_vcpu_locked = vcpu_lock(target_vcpu);
 
@@ -275,8 +281,11 @@ out:
  * Saves the state of per-vCPU peripherals, such as the virtual timer, and
  * informs the arch-independent sections that registers have been saved.
  */
-void complete_saving_state(struct vcpu *vcpu)
+HOT_TEXT void complete_saving_state(struct vcpu *vcpu)
 {
+	fpsimd_switch_out(vcpu);
+	vgic_lr_save(vcpu);
+
 	if (has_vhe_support()) {
 		vcpu->regs.peripherals.cntv_cval_el0 =
 			read_msr(MSR_CNTV_CVAL_EL02);
@@ -317,8 +326,11 @@ void complete_saving_state(struct vcpu *vcpu)
 /**
  * Restores the state of per-vCPU peripherals, such as the virtual timer.
  */
-void begin_restoring_state(struct vcpu *vcpu)
+HOT_TEXT void begin_restoring_state(struct vcpu *vcpu)
 {
+	fpsimd_switch_in(vcpu);
+	vgic_lr_restore(vcpu);
+
 	/*
 	 * Clear timer control register before restoring compare value, to avoid
 	 * a spurious timer interrupt. This could be a problem if the interrupt
@@ -384,7 +396,7 @@ static void invalidate_vm_tlb(void)
  * workaround:
  * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/commit/?id=94d0e5980d6791b9
  */
-void maybe_invalidate_tlb(struct vcpu *vcpu)
+HOT_TEXT void maybe_invalidate_tlb(struct vcpu *vcpu)
 {
 	size_t   current_cpu_index = cpu_index(vcpu->cpu);
 	uint16_t new_vcpu_index    = vcpu_index(vcpu);
@@ -403,7 +415,7 @@ void maybe_invalidate_tlb(struct vcpu *vcpu)
 	}
 }
 
-noreturn void irq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
+COLD_TEXT noreturn void irq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 {
 	(void)elr;
 	(void)spsr;
@@ -411,7 +423,7 @@ noreturn void irq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 	panic("IRQ from current exception level.");
 }
 
-noreturn void fiq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
+COLD_TEXT noreturn void fiq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 {
 	(void)elr;
 	(void)spsr;
@@ -419,7 +431,7 @@ noreturn void fiq_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 	panic("FIQ from current exception level.");
 }
 
-noreturn void serr_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
+COLD_TEXT noreturn void serr_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 {
 	(void)elr;
 	(void)spsr;
@@ -427,7 +439,7 @@ noreturn void serr_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 	panic("SError from current exception level.");
 }
 
-noreturn void sync_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
+COLD_TEXT noreturn void sync_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 {
 	uintreg_t esr = read_msr(esr_el2);
 	uintreg_t ec = GET_ESR_EC(esr);
@@ -585,10 +597,37 @@ static void smc_forwarder(const struct vm *vm, struct ffa_value *args)
 
 /**
  * Set or clear VI/VF bits according to pending interrupts.
+ *
+ * For the current vCPU only the live HCR_EL2 of this CPU is written, so the
+ * pending counters are read without taking the vCPU lock. Holding it would
+ * not close any window: the bits only take effect at the ERET, after the lock
+ * would have been released again. What keeps an injection from being lost is
+ * the order on the injecting side, under the vCPU lock:
+ *  1. the pending bit is set, then the counter is incremented with release
+ *     semantics, which pairs with the acquire in
+ *     vcpu_interrupt_irq_count_read(), so a non-zero count read here implies
+ *     the pending bit is visible to the guest's pg_interrupt_get();
+ *  2. the injector then looks at the target: if it runs on another CPU it is
+ *     kicked (arch_vcpu_kick()) or the primary is told to run it (ret 1), so
+ *     it exits once more and comes back through here, observing the count.
+ * An injection on this CPU is ordered before this read by program order.
+ *
+ * The saved registers of another vCPU can be written by any CPU switching to
+ * it, so they are updated with its lock held.
+ *
+ * vCPUs with list registers are never signalled through VI/VF; their pending
+ * interrupts are moved into the list registers instead.
  */
 static void vcpu_update_virtual_interrupts(struct vcpu *next)
 {
 	struct vcpu_locked vcpu_locked;
+	struct vcpu *vcpu;
+
+	vcpu = next == NULL ? current() : next;
+	if (vgic_lr_enabled(vcpu)) {
+		vgic_lr_flush(vcpu, vcpu == current());
+		return;
+	}
 
 	if (next == NULL) {
 		/*
@@ -596,12 +635,9 @@ static void vcpu_update_virtual_interrupts(struct vcpu *next)
 		 * directly in the register.
 		 */
 
-		vcpu_locked = vcpu_lock(current());
-		set_virtual_irq_current(
-			vcpu_interrupt_irq_count_get(vcpu_locked) > 0);
-		set_virtual_fiq_current(
-			vcpu_interrupt_fiq_count_get(vcpu_locked) > 0);
-		vcpu_unlock(&vcpu_locked);
+		vcpu = current();
+		set_virtual_irq_current(vcpu_interrupt_irq_count_read(vcpu) > 0);
+		set_virtual_fiq_current(vcpu_interrupt_fiq_count_read(vcpu) > 0);
 	} else {
 		/*
 		 * About to switch vCPUs, set the bit for the vCPU to which we
@@ -806,7 +842,7 @@ static void inject_el1_unknown_exception(struct vcpu *vcpu, uintreg_t esr_el2)
 	inject_el1_exception(vcpu, esr_el1_value, far_el1_value);
 }
 
-static struct vcpu *hvc_handler(struct vcpu *vcpu)
+static HOT_TEXT struct vcpu *hvc_handler(struct vcpu *vcpu)
 {
 	struct ffa_value args = arch_regs_get_args(&vcpu->regs);
 	struct vcpu *next = NULL;
@@ -816,6 +852,15 @@ static struct vcpu *hvc_handler(struct vcpu *vcpu)
 	}
 
 	switch (args.func) {
+	/* Normally on the fast path, unless built with HVC_FAST_PATH=n. */
+	case FFA_VERSION_32:
+		arch_regs_set_retval(&vcpu->regs, api_ffa_version(args.arg1));
+		break;
+
+	case FFA_ID_GET_32:
+		arch_regs_set_retval(&vcpu->regs, api_ffa_id_get(vcpu));
+		break;
+
 	case PG_INTERRUPT_ENABLE:
 		vcpu->regs.r[0] = api_interrupt_enable(args.arg1, args.arg2,
 						       args.arg3, vcpu);
@@ -825,11 +870,32 @@ static struct vcpu *hvc_handler(struct vcpu *vcpu)
 		vcpu->regs.r[0] = api_interrupt_get(vcpu);
 		break;
 
+	case PG_INTERRUPT_SET_PRIORITY:
+		vcpu->regs.r[0] =
+			api_interrupt_set_priority(args.arg1, args.arg2, vcpu);
+		break;
+
 	case PG_INTERRUPT_INJECT:
 		vcpu->regs.r[0] = api_interrupt_inject(args.arg1, args.arg2,
 						       args.arg3, vcpu, &next);
 		break;
 
+	case PG_LOCK_STATS_DUMP:
+		vcpu->regs.r[0] = api_lock_stats_dump(args.arg1, vcpu);
+		break;
+
+	case PG_EXIT_TRACE_MAP:
+		vcpu->regs.r[0] = exit_trace_map(vcpu);
+		break;
+
+	case PG_HALT_POLL_STATS_DUMP:
+		vcpu->regs.r[0] = halt_poll_stats_dump(vcpu);
+		break;
+
+	case PG_VGIC_WRITE_STATS_DUMP:
+		vcpu->regs.r[0] = vgic_write_stats_dump(vcpu);
+		break;
+
 	default:
 		vcpu->regs.r[0] = SMCCC_ERROR_UNKNOWN;
 	}
@@ -839,9 +905,104 @@ static struct vcpu *hvc_handler(struct vcpu *vcpu)
 	return next;
 }
 
-struct vcpu *irq_lower(void)
+/**
+ * Sets or clears the VI/VF bits of the live HCR_EL2 according to pending
+ * interrupts. Only valid on the hypercall fast path, where the register has
+ * not been saved to the vCPU.
+ */
+static void vcpu_update_virtual_interrupts_live(struct vcpu *vcpu)
+{
+	uintreg_t hcr_el2;
+	uintreg_t new_hcr_el2;
+
+	if (vgic_lr_enabled(vcpu)) {
+		vgic_lr_flush(vcpu, true);
+		return;
+	}
+
+	hcr_el2 = read_msr(hcr_el2);
+	new_hcr_el2 = hcr_el2 & ~(HCR_EL2_VI | HCR_EL2_VF);
+
+	if (vcpu_interrupt_irq_count_read(vcpu) > 0) {
+		new_hcr_el2 |= HCR_EL2_VI;
+	}
+
+	if (vcpu_interrupt_fiq_count_read(vcpu) > 0) {
+		new_hcr_el2 |= HCR_EL2_VF;
+	}
+
+	if (new_hcr_el2 != hcr_el2) {
+		write_msr(hcr_el2, new_hcr_el2);
+	}
+}
+
+/**
+ * Handles the hypercalls whitelisted by the fast path in exceptions.S. None of
+ * them may block or switch vCPUs.
+ *
+ * Only x0-x17 and x30 of the vCPU have been saved; the rest of its state,
+ * including HCR_EL2, is still live in the CPU and the handler must not touch
+ * it other than through vcpu_update_virtual_interrupts_live().
+ */
+HOT_TEXT void hvc_fast_handler(struct vcpu *vcpu)
+{
+	uint64_t entry_ticks = exit_trace_enter();
+	struct ffa_value args = arch_regs_get_args(&vcpu->regs);
+
+	switch (args.func) {
+	case FFA_VERSION_32:
+		arch_regs_set_retval(&vcpu->regs, api_ffa_version(args.arg1));
+		break;
+
+	case FFA_ID_GET_32:
+		arch_regs_set_retval(&vcpu->regs, api_ffa_id_get(vcpu));
+		break;
+
+	case PG_INTERRUPT_ENABLE:
+		vcpu->regs.r[0] = api_interrupt_enable(args.arg1, args.arg2,
+						       args.arg3, vcpu);
+		vcpu_update_virtual_interrupts_live(vcpu);
+		break;
+
+	case PG_INTERRUPT_GET:
+		vcpu->regs.r[0] = api_interrupt_get(vcpu);
+		vcpu_update_virtual_interrupts_live(vcpu);
+		break;
+
+	default:
+		panic("Hypercall %#x is not on the fast path.", args.func);
+	}
+
+	exit_trace_sync(read_msr(esr_el2), 0, entry_ticks);
+}
+
+/**
+ * Handles the system register writes whitelisted by the fast path in
+ * exceptions.S, currently only ICC_SGI1R_EL1. The same restrictions as for
+ * hvc_fast_handler() apply; the source register is one of those saved, and the
+ * trapped instruction is skipped by advancing the live ELR_EL2.
+ */
+HOT_TEXT void sysreg_fast_handler(struct vcpu *vcpu)
+{
+	uint64_t entry_ticks = exit_trace_enter();
+	uintreg_t esr = read_msr(esr_el2);
+	uintreg_t rt_register = GET_ISS_RT(esr);
+
+	CHECK(GET_ISS_SYSREG(esr) == ICC_SGI1R_EL1_WRITE_ISS &&
+	      !ISS_IS_READ(esr));
+
+	emulate_sgi1r_write(vcpu, rt_register != RT_REG_XZR
+					  ? vcpu->regs.r[rt_register]
+					  : 0);
+	write_msr(elr_el2, read_msr(elr_el2) + GET_NEXT_PC_INC(esr));
+
+	exit_trace_sync(esr, 0, entry_ticks);
+}
+
+HOT_TEXT struct vcpu *irq_lower(void)
 {
 	/* New: we handle interrupts in the hypervisor instead of primary VM */
+	uint64_t entry_ticks = exit_trace_enter();
 	struct vcpu *vcpu = current();
 	struct vcpu *target_vcpu = NULL;
 	delegate_interrupt(vcpu, &target_vcpu);
@@ -852,6 +1013,8 @@ struct vcpu *irq_lower(void)
 	 */
 	vcpu_update_virtual_interrupts(target_vcpu);
 
+	exit_trace_irq(entry_ticks);
+
 	return target_vcpu;
 	
 	// /* Old:
@@ -866,12 +1029,12 @@ struct vcpu *irq_lower(void)
 	// return api_preempt(current());
 }
 
-struct vcpu *fiq_lower(void)
+HOT_TEXT struct vcpu *fiq_lower(void)
 {
 	return irq_lower();
 }
 
-noreturn struct vcpu *serr_lower(void)
+COLD_TEXT noreturn struct vcpu *serr_lower(void)
 {
 	/*
 	 * SError exceptions should be isolated and handled by the responsible
@@ -922,10 +1085,42 @@ static struct vcpu_fault_info fault_info_init(uintreg_t esr,
 	return r;
 }
 
-struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
+/**
+ * Idles the physical CPU in EL2 on a WFI of a vCPU that owns it, instead of
+ * switching to the primary VM and back.
+ *
+ * The WFI is executed with interrupts masked at EL2; a pending physical
+ * interrupt (a device interrupt routed to the VM or the vCPU's timer) still
+ * wakes the core and is taken by irq_lower() as soon as the vCPU is resumed,
+ * which completes the guest's WFI.
+ *
+ * Returns true if the WFI has been handled and the vCPU is to be resumed.
+ */
+static bool wfi_idle_in_el2(struct vcpu *vcpu)
+{
+	struct cpu *c = vcpu->cpu;
+
+	if (!vcpu->vm->wfi_idle || c->vm != vcpu->vm ||
+	    vm_get_vcpu(c->vm, c->vcpu_index) != vcpu ||
+	    (read_msr(mpidr_el1) & MPIDR_EL1_AFFINITY_MASK) != c->id) {
+		return false;
+	}
+
+	if (vcpu_interrupt_irq_count_read(vcpu) == 0 &&
+	    vcpu_interrupt_fiq_count_read(vcpu) == 0) {
+		dsb(sy);
+		__asm__ volatile("wfi");
+	}
+
+	return true;
+}
+
+static HOT_TEXT struct vcpu *handle_sync_lower_exception(uintreg_t esr,
+							 uintreg_t far)
 {
 	struct vcpu *vcpu = current();
 	struct vcpu_fault_info info;
+	const struct mmio_region *region;
 	struct vcpu *new_vcpu = vcpu;
 	uintreg_t ec = GET_ESR_EC(esr);
 
@@ -944,33 +1139,34 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 			return new_vcpu;
 		}
 		/* WFI */
+		if (vgic_lr_pending(vcpu) || wfi_idle_in_el2(vcpu) ||
+		    halt_poll(vcpu)) {
+			vcpu_update_virtual_interrupts(NULL);
+			return NULL;
+		}
 		return api_wait_for_interrupt(vcpu);
 
+	case EC_FP_SIMD:
+		/* First FP/SIMD access since the vCPU was switched in. */
+		fpsimd_access_trap(vcpu);
+		return NULL;
+
 	case EC_DATA_ABORT_LOWER_EL:
 		info = fault_info_init(
 			esr, vcpu, (esr & (1U << 6)) ? MM_MODE_W : MM_MODE_R);
 
-		if((info.ipaddr.ipa >= VIRTIO_START) && (info.ipaddr.ipa <= VIRTIO_END)) {
-		    if(virtioac_handle(esr, far, GET_NEXT_PC_INC(esr), vcpu, &info)) {
-		        return NULL;
-		    }
-		}
-		else
-		{
-            /* try to resolve this as a virtual device access */
-            if (access_virt_dev(esr, far, GET_NEXT_PC_INC(esr), vcpu, &info)) {
-                return NULL;
-            }
-
-            /* try to resolve this as a GIC access */
-            if (access_gicv3(esr, far, GET_NEXT_PC_INC(esr), vcpu, &info)) {
-                return NULL;
-            }
+		/* hand emulated MMIO accesses to the emulator in charge */
+		region = mmio_region_find(&vcpu->vm->mmio, info.ipaddr.ipa);
+		if (region != NULL) {
+			if (region->access(esr, far, GET_NEXT_PC_INC(esr), vcpu,
+					   &info, region)) {
+				return NULL;
+			}
 
 			dlog_warning("Data Abort | PC:%#x IPA:%#x\n",
-				vcpu->regs.pc,
-				info.ipaddr.ipa);
+				     vcpu->regs.pc, info.ipaddr.ipa);
 		}
+
 		if (vcpu_handle_page_fault(vcpu, &info)) {
 			return NULL;
 		}
@@ -1029,47 +1225,112 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 	return NULL;
 }
 
+HOT_TEXT struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
+{
+	uint64_t entry_ticks = exit_trace_enter();
+	struct vcpu *next = handle_sync_lower_exception(esr, far);
+
+	exit_trace_sync(esr, far, entry_ticks);
+
+	return next;
+}
+
 /**
- * Handles EC = 011000, MSR, MRS instruction traps.
- * Returns non-null ONLY if the access failed and the vCPU is changing.
+ * Emulates a trapped system register access. Returns true if the access was
+ * allowed and performed, false otherwise.
  */
-void handle_system_register_access(uintreg_t esr_el2)
+typedef bool (*sysreg_access_t)(struct vcpu *vcpu, uint16_t vm_id,
+				uintreg_t esr);
+
+static bool feature_id_access(struct vcpu *vcpu, uint16_t vm_id, uintreg_t esr)
+{
+	(void)vm_id;
+	return feature_id_process_access(vcpu, esr);
+}
+
+static bool icc_icv_access(struct vcpu *vcpu, uint16_t vm_id, uintreg_t esr)
+{
+	(void)vm_id;
+	return icc_icv_process_access(vcpu, esr);
+}
+
+static bool cache_maintenance_access(struct vcpu *vcpu, uint16_t vm_id,
+				     uintreg_t esr)
+{
+	(void)vm_id;
+	return process_cache_maintenance(vcpu, esr);
+}
+
+/**
+ * Trapped system register accesses are dispatched with a two-level table: the
+ * first level maps op0/op1/CRn to a row of the second level, which maps CRm to
+ * the handler. All handled register groups are fully described by these four
+ * fields, op2 is left to the handlers. The groups are the ones of the
+ * Arm Architecture Reference Manual Table D12-2.
+ */
+enum sysreg_row {
+	SYSREG_ROW_NONE,
+	SYSREG_ROW_DEBUG,
+	SYSREG_ROW_FEATURE_ID,
+	SYSREG_ROW_PMINTEN,
+	SYSREG_ROW_PMU,
+	SYSREG_ROW_PMEV,
+	SYSREG_ROW_ICC_PMR,
+	SYSREG_ROW_ICC,
+	SYSREG_ROW_DC,
+};
+
+#define SYSREG_ROW_INDEX(op0, op1, crn) (((op0) << 7) | ((op1) << 4) | (crn))
+
+static const uint8_t sysreg_row_of[SYSREG_ROW_INDEX(4, 0, 0)] = {
+	/* op0 == 2 is for debug and trace, op1 == 1 for trace. */
+	[SYSREG_ROW_INDEX(2, 0, 0) ... SYSREG_ROW_INDEX(2, 0, 15)] =
+		SYSREG_ROW_DEBUG,
+	[SYSREG_ROW_INDEX(2, 2, 0) ... SYSREG_ROW_INDEX(2, 7, 15)] =
+		SYSREG_ROW_DEBUG,
+	[SYSREG_ROW_INDEX(3, 0, 0)] = SYSREG_ROW_FEATURE_ID,
+	[SYSREG_ROW_INDEX(3, 0, 9)] = SYSREG_ROW_PMINTEN,
+	[SYSREG_ROW_INDEX(3, 3, 9)] = SYSREG_ROW_PMU,
+	[SYSREG_ROW_INDEX(3, 3, 14)] = SYSREG_ROW_PMEV,
+	[SYSREG_ROW_INDEX(3, 0, 4)] = SYSREG_ROW_ICC_PMR,
+	[SYSREG_ROW_INDEX(3, 0, 12)] = SYSREG_ROW_ICC,
+	[SYSREG_ROW_INDEX(1, 0, 7)] = SYSREG_ROW_DC,
+};
+
+static const sysreg_access_t sysreg_handler_of[][16] = {
+	[SYSREG_ROW_DEBUG] = {[0 ... 15] = debug_el1_process_access},
+	/* ID_AA64*_EL1 and friends. */
+	[SYSREG_ROW_FEATURE_ID] = {[1 ... 7] = feature_id_access},
+	/* PMINTENSET_EL1, PMINTENCLR_EL1. */
+	[SYSREG_ROW_PMINTEN] = {[14] = perfmon_process_access},
+	/* Remaining performance monitor registers. */
+	[SYSREG_ROW_PMU] = {[12 ... 14] = perfmon_process_access},
+	/* PMEVCNTRn_EL0, PMEVTYPERn_EL0, PMCCFILTR_EL0. */
+	[SYSREG_ROW_PMEV] = {[8 ... 15] = perfmon_process_access},
+	[SYSREG_ROW_ICC_PMR] = {[6] = icc_icv_access},
+	[SYSREG_ROW_ICC] = {[8 ... 12] = icc_icv_access},
+	/* DC by set/way and by VA to PoC. */
+	[SYSREG_ROW_DC] = {[6] = cache_maintenance_access,
+			   [10] = cache_maintenance_access,
+			   [14] = cache_maintenance_access},
+};
+
+static HOT_TEXT void process_system_register_access(uintreg_t esr_el2)
 {
 	struct vcpu *vcpu = current();
-	uint16_t vm_id = vcpu->vm->id;
 	uintreg_t ec = GET_ESR_EC(esr_el2);
+	uint8_t row;
+	sysreg_access_t access;
 
 	CHECK(ec == EC_MSR);
-	/*
-	 * Handle accesses to debug and performance monitor registers.
-	 * Inject an exception for unhandled/unsupported registers.
-	 */
-	if (debug_el1_is_register_access(esr_el2)) {
-		if (!debug_el1_process_access(vcpu, vm_id, esr_el2)) {
-			inject_el1_unknown_exception(vcpu, esr_el2);
-			return;
-		}
-	} else if (perfmon_is_register_access(esr_el2)) {
-		if (!perfmon_process_access(vcpu, vm_id, esr_el2)) {
-			inject_el1_unknown_exception(vcpu, esr_el2);
-			return;
-		}
-	} else if (feature_id_is_register_access(esr_el2)) {
-		if (!feature_id_process_access(vcpu, esr_el2)) {
-			inject_el1_unknown_exception(vcpu, esr_el2);
-			return;
-		}
-	} else if (icc_icv_is_register_access(esr_el2)) {
-		if (!icc_icv_process_access(vcpu, esr_el2)) {
-			inject_el1_unknown_exception(vcpu, esr_el2);
-			return;
-		}
-	} else if (is_cache_maintenance(esr_el2)) {
-		if (!process_cache_maintenance(vcpu, esr_el2)) {
-			inject_el1_unknown_exception(vcpu, esr_el2);
-			return;
-		}
-	} else {
+
+	row = sysreg_row_of[SYSREG_ROW_INDEX(GET_ISS_OP0(esr_el2),
+					     GET_ISS_OP1(esr_el2),
+					     GET_ISS_CRN(esr_el2))];
+	access = sysreg_handler_of[row][GET_ISS_CRM(esr_el2)];
+
+	/* Inject an exception for unhandled/unsupported registers. */
+	if (access == NULL || !access(vcpu, vcpu->vm->id, esr_el2)) {
 		inject_el1_unknown_exception(vcpu, esr_el2);
 		return;
 	}
@@ -1077,3 +1338,16 @@ void handle_system_register_access(uintreg_t esr_el2)
 	/* Instruction was fulfilled. Skip it and run the next one. */
 	vcpu->regs.pc += GET_NEXT_PC_INC(esr_el2);
 }
+
+/**
+ * Handles EC = 011000, MSR, MRS instruction traps.
+ * Returns non-null ONLY if the access failed and the vCPU is changing.
+ */
+HOT_TEXT void handle_system_register_access(uintreg_t esr_el2)
+{
+	uint64_t entry_ticks = exit_trace_enter();
+
+	process_system_register_access(esr_el2);
+
+	exit_trace_sync(esr_el2, 0, entry_ticks);
+}
@@ -12,6 +12,10 @@
 #include "pg/offset_size_header.h"
 #include "pg/vm.h"
 
+#include "vmapi/pg/abi.h"
+
+#include "sysregs.h"
+
 DEFINE_SIZEOF(CPU_SIZE, struct cpu)
 
 DEFINE_OFFSETOF(CPU_ID, struct cpu, id)
@@ -27,6 +31,15 @@ DEFINE_OFFSETOF(VCPU_PAC, struct vcpu, regs.pac)
 
 DEFINE_OFFSETOF(VM_ID, struct vm, id)
 
+/* Function IDs handled by the hypercall fast path in exceptions.S. */
+DEFINE_VALUE(HVC_FAST_INTERRUPT_ENABLE, PG_INTERRUPT_ENABLE)
+DEFINE_VALUE(HVC_FAST_INTERRUPT_GET, PG_INTERRUPT_GET)
+DEFINE_VALUE(HVC_FAST_FFA_VERSION, FFA_VERSION_32)
+DEFINE_VALUE(HVC_FAST_FFA_ID_GET, FFA_ID_GET_32)
+
+/* System register writes handled by the fast path in exceptions.S. */
+DEFINE_VALUE(SYSREG_FAST_SGI1R_ISS, ICC_SGI1R_EL1_WRITE_ISS)
+
 #if GIC_VERSION == 3 || GIC_VERSION == 4
 DEFINE_OFFSETOF(VCPU_GIC, struct vcpu, regs.gic)
 #endif
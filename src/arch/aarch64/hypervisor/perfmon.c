@@ -118,33 +118,6 @@
 
 /* clang-format on */
 
-/**
- * Returns true if the ESR register shows an access to a performance monitor
- * register.
- */
-bool perfmon_is_register_access(uintreg_t esr)
-{
-	uintreg_t op0 = GET_ISS_OP0(esr);
-	uintreg_t op1 = GET_ISS_OP1(esr);
-	uintreg_t crn = GET_ISS_CRN(esr);
-	uintreg_t crm = GET_ISS_CRM(esr);
-
-	/* From the Arm Architecture Reference Manual Table D12-2. */
-
-	/* For PMINTENCLR_EL1 and PMINTENSET_EL1*/
-	if (op0 == 3 && op1 == 0 && crn == 9 && crm == 14) {
-		return true;
-	}
-
-	/* For PMEVCNTRn_EL0, PMEVTYPERn_EL0, and PMCCFILTR_EL0. */
-	if (op0 == 3 && op1 == 3 && crn == 14 && crm >= 8 && crm <= 15) {
-		return true;
-	}
-
-	/* For all remaining performance monitor registers. */
-	return op0 == 3 && op1 == 3 && crn == 9 && crm >= 12 && crm <= 14;
-}
-
 /**
  * Processes an access (msr, mrs) to a performance monitor register.
  * Returns true if the access was allowed and performed, false otherwise.
@@ -64,8 +64,6 @@
  */
 #define PMCCFILTR_EL0_SH 0x1000000
 
-bool perfmon_is_register_access(uintreg_t esr_el2);
-
 bool perfmon_process_access(struct vcpu *vcpu, uint16_t vm_id,
 			    uintreg_t esr_el2);
 
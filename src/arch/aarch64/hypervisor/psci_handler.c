@@ -227,6 +227,13 @@ bool psci_primary_vm_handler(struct vcpu *vcpu, uint32_t func, uintreg_t arg0,
 			break;
 		}
 
+		/*
+		 * Move the VM's interrupts to one of its remaining CPUs, or
+		 * disable them if this was the last one.
+		 */
+		vm_set_vcpu_online(vcpu->vm, vcpu_index(vcpu), false);
+		reroute_all_interrupts(vcpu->vm, vcpu->cpu->id);
+
 		cpu_off(vcpu->cpu);
 		smc32(PSCI_CPU_OFF, 0, 0, 0, 0, 0, 0, SMCCC_CALLER_HYPERVISOR);
 		panic("CPU off failed");
@@ -0,0 +1,780 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "vgic_lr.h"
+
+#if GIC_VERSION == 3 || GIC_VERSION == 4
+
+#include "pg/arch/barriers.h"
+#include "pg/code_layout.h"
+#include "pg/interrupt_desc.h"
+#include "pg/plat/interrupts.h"
+#include "pg/static_assert.h"
+#include "pg/std.h"
+
+#include "msr.h"
+#include "sysregs.h"
+
+/* SGIs and PPIs are banked per CPU and always belong to the running vCPU */
+#define VGIC_LR_PPI_BASE 16
+#define VGIC_LR_SPI_BASE 32
+
+/* first of the special INTIDs returned on a spurious acknowledge */
+#define VGIC_LR_SPECIAL_BASE 1020
+
+/* only SGIs and PPIs go through the vCPU's interrupt bitmaps */
+static_assert(PG_NUM_INTIDS >= VGIC_LR_SPI_BASE,
+              "interrupt bitmaps must cover SGIs and PPIs");
+/* words of the held interrupt bitmap in struct arch_regs */
+#define VGIC_LR_HELD_WORDS \
+    (sizeof(((struct arch_regs *) 0)->gic.hw_held) / sizeof(uint32_t))
+
+static_assert(VGIC_LR_HELD_WORDS * INTERRUPT_REGISTER_BITS
+              >= VGIC_LR_SPECIAL_BASE,
+              "held interrupt bitmap must cover all SPIs");
+
+/* physical priority of the maintenance interrupt */
+#define VGIC_LR_MAINTENANCE_PRIORITY 0x80
+
+/* ICC_CTLR_EL1.EOImode; EOIR only drops priority, DIR deactivates */
+#define ICC_CTLR_EL1_EOIMODE (UINT64_C(0x1) << 1)
+
+/* physical CPU interface state of a CPU, see vgic_lr_cpu_setup() */
+struct vgic_lr_cpu {
+    bool     ready;  /* maintenance interrupt and kick SGI configured */
+    uint64_t ctlr;   /* ICC_CTLR_EL1 to restore on switch-out         */
+    uint8_t  pmr;    /* priority mask to restore on switch-out        */
+};
+
+static struct vgic_lr_cpu vgic_lr_cpus[MAX_CPUS];
+
+#define ICH_LR_READ(n) \
+    case n:            \
+        return read_msr(ich_lr##n##_el2)
+
+#define ICH_LR_WRITE(n, v)              \
+    case n:                             \
+        write_msr(ich_lr##n##_el2, v);  \
+        break
+
+/* ich_lr_read - Reads a list register of the current CPU
+ *  @n : list register index
+ *
+ *  @return : register value
+ */
+static uint64_t
+ich_lr_read(uint32_t n)
+{
+    switch (n) {
+        ICH_LR_READ(0);  ICH_LR_READ(1);  ICH_LR_READ(2);  ICH_LR_READ(3);
+        ICH_LR_READ(4);  ICH_LR_READ(5);  ICH_LR_READ(6);  ICH_LR_READ(7);
+        ICH_LR_READ(8);  ICH_LR_READ(9);  ICH_LR_READ(10); ICH_LR_READ(11);
+        ICH_LR_READ(12); ICH_LR_READ(13); ICH_LR_READ(14); ICH_LR_READ(15);
+    }
+
+    return 0;
+}
+
+/* ich_lr_write - Writes a list register of the current CPU
+ *  @n     : list register index
+ *  @value : new register value
+ */
+static void
+ich_lr_write(uint32_t n, uint64_t value)
+{
+    switch (n) {
+        ICH_LR_WRITE(0, value);  ICH_LR_WRITE(1, value);
+        ICH_LR_WRITE(2, value);  ICH_LR_WRITE(3, value);
+        ICH_LR_WRITE(4, value);  ICH_LR_WRITE(5, value);
+        ICH_LR_WRITE(6, value);  ICH_LR_WRITE(7, value);
+        ICH_LR_WRITE(8, value);  ICH_LR_WRITE(9, value);
+        ICH_LR_WRITE(10, value); ICH_LR_WRITE(11, value);
+        ICH_LR_WRITE(12, value); ICH_LR_WRITE(13, value);
+        ICH_LR_WRITE(14, value); ICH_LR_WRITE(15, value);
+    }
+}
+
+/* vgic_lr_count - Returns the number of implemented list registers */
+static uint32_t
+vgic_lr_count(void)
+{
+    return (read_msr(ich_vtr_el2) & ICH_VTR_EL2_LIST_REGS_MASK) + 1;
+}
+
+/* vgic_lr_apr_count - Returns the number of implemented ICH_AP<g>R<n>_EL2
+ *
+ *  @return : 1, 2 or 4 for 5, 6 or 7 bits of preemption
+ */
+static uint32_t
+vgic_lr_apr_count(void)
+{
+    uint64_t pre_bits;  /* number of preemption bits minus one */
+
+    pre_bits = (read_msr(ich_vtr_el2) >> ICH_VTR_EL2_PRE_BITS_SHIFT)
+             & ICH_VTR_EL2_PRE_BITS_MASK;
+
+    return 1U << (pre_bits - 4);
+}
+
+/* vgic_lr_get - Reads a list register of a vCPU
+ *  @vcpu : vCPU the list registers belong to
+ *  @live : whether the vCPU's list registers are loaded in the CPU
+ *  @n    : list register index
+ *
+ *  @return : register value
+ */
+static uint64_t
+vgic_lr_get(struct vcpu *vcpu, bool live, uint32_t n)
+{
+    return live ? ich_lr_read(n) : vcpu->regs.gic.ich_lr_el2[n];
+}
+
+/* vgic_lr_set - Writes a list register of a vCPU
+ *  @vcpu  : vCPU the list registers belong to
+ *  @live  : whether the vCPU's list registers are loaded in the CPU
+ *  @n     : list register index
+ *  @value : new register value
+ */
+static void
+vgic_lr_set(struct vcpu *vcpu, bool live, uint32_t n, uint64_t value)
+{
+    if (live)
+        ich_lr_write(n, value);
+    else
+        vcpu->regs.gic.ich_lr_el2[n] = value;
+}
+
+/* vgic_lr_empty - Finds the list registers that do not hold an interrupt
+ *  @vcpu : vCPU the list registers belong to
+ *  @live : whether the vCPU's list registers are loaded in the CPU
+ *  @nr   : number of implemented list registers
+ *
+ *  @return : bitmap of empty list registers
+ */
+static uint32_t
+vgic_lr_empty(struct vcpu *vcpu, bool live, uint32_t nr)
+{
+    uint32_t empty = 0;  /* result */
+
+    if (live)
+        return read_msr(ich_elrsr_el2) & ((1U << nr) - 1);
+
+    for (uint32_t n = 0; n < nr; ++n)
+        if (!(vcpu->regs.gic.ich_lr_el2[n] & ICH_LR_EL2_STATE_MASK))
+            empty |= 1U << n;
+
+    return empty;
+}
+
+/* vgic_lr_find - Finds the list register that holds an interrupt
+ *  @vcpu  : vCPU the list registers belong to
+ *  @live  : whether the vCPU's list registers are loaded in the CPU
+ *  @nr    : number of implemented list registers
+ *  @empty : bitmap of empty list registers
+ *  @intid : virtual interrupt ID
+ *
+ *  @return : list register index; nr if the interrupt is not listed
+ */
+static uint32_t
+vgic_lr_find(struct vcpu *vcpu, bool live, uint32_t nr, uint32_t empty,
+             uint32_t intid)
+{
+    for (uint32_t n = 0; n < nr; ++n) {
+        if (empty & (1U << n))
+            continue;
+
+        if ((vgic_lr_get(vcpu, live, n) & ICH_LR_EL2_VINTID_MASK) == intid)
+            return n;
+    }
+
+    return nr;
+}
+
+/* vgic_lr_is_irq - Checks whether a virtual interrupt is signalled as IRQ
+ *  @vcpu  : vCPU the interrupt belongs to
+ *  @intid : virtual interrupt ID
+ *
+ *  @return : true for IRQ (Group 1), false for FIQ
+ *
+ * INTIDs beyond the vCPU's interrupt bitmaps are always IRQs.
+ */
+static bool
+vgic_lr_is_irq(const struct vcpu *vcpu, uint32_t intid)
+{
+    if (intid >= PG_NUM_INTIDS)
+        return true;
+
+    return !(vcpu->interrupts.interrupt_type[intid / INTERRUPT_REGISTER_BITS]
+             & (1U << (intid % INTERRUPT_REGISTER_BITS)));
+}
+
+/* vgic_lr_priority - Returns the list register priority of an interrupt
+ *  @vcpu  : vCPU the interrupt belongs to
+ *  @intid : virtual interrupt ID
+ *
+ *  @return : 8-bit GIC priority, of which the virtual CPU interface
+ *            implements at least the upper INTERRUPT_PRIORITY_BITS
+ *
+ * This is the priority set for the interrupt through the hypervisor, the same
+ * that orders the vCPU's pending interrupts. INTIDs beyond the vCPU's
+ * interrupt bitmaps have none and are listed with VGIC_LR_DEFAULT_PRIORITY.
+ */
+static uint64_t
+vgic_lr_priority(const struct vcpu *vcpu, uint32_t intid)
+{
+    if (intid >= PG_NUM_INTIDS)
+        return VGIC_LR_DEFAULT_PRIORITY;
+
+    return (uint64_t) vcpu->interrupts.interrupt_priority[intid]
+           << (8 - INTERRUPT_PRIORITY_BITS);
+}
+
+/* vgic_lr_hw_value - Builds a list register for a hardware-mapped interrupt
+ *  @vcpu  : vCPU the interrupt belongs to
+ *  @intid : physical interrupt ID, which is also the virtual one
+ *
+ *  @return : list register value
+ */
+static uint64_t
+vgic_lr_hw_value(const struct vcpu *vcpu, uint32_t intid)
+{
+    return intid
+         | ((uint64_t) intid << ICH_LR_EL2_PINTID_SHIFT)
+         | (vgic_lr_priority(vcpu, intid) << ICH_LR_EL2_PRIORITY_SHIFT)
+         | (vgic_lr_is_irq(vcpu, intid) ? ICH_LR_EL2_GROUP1 : 0)
+         | ICH_LR_EL2_HW
+         | ICH_LR_EL2_STATE_PENDING;
+}
+
+/* vgic_lr_set_uie - Requests or cancels the underflow maintenance interrupt
+ *  @vcpu   : vCPU the list registers belong to
+ *  @live   : whether the vCPU's GIC state is loaded in the CPU
+ *  @enable : whether interrupts are waiting for a free list register
+ */
+static void
+vgic_lr_set_uie(struct vcpu *vcpu, bool live, bool enable)
+{
+    uint64_t hcr;  /* ICH_HCR_EL2 of the vCPU */
+
+    hcr = live ? read_msr(ich_hcr_el2) : vcpu->regs.gic.ich_hcr_el2;
+
+    if (enable == !!(hcr & ICH_HCR_EL2_UIE))
+        return;
+
+    hcr ^= ICH_HCR_EL2_UIE;
+
+    if (live)
+        write_msr(ich_hcr_el2, hcr);
+    else
+        vcpu->regs.gic.ich_hcr_el2 = hcr;
+}
+
+/* vgic_lr_regs_reset - Initializes the virtual CPU interface of a vCPU
+ *  @vcpu : vCPU whose registers are being reset
+ *
+ * Physical interrupts are taken to EL2, which also makes the guest's ICC_*
+ * accesses target the virtual CPU interface. Common register accesses are no
+ * longer trapped (ICH_HCR_EL2.TC is clear).
+ */
+void
+vgic_lr_regs_reset(struct vcpu *vcpu)
+{
+    struct arch_regs *r = &vcpu->regs;  /* register save area */
+
+    if (!vgic_lr_enabled(vcpu))
+        return;
+
+    r->hcr_el2 |= HCR_EL2_IMO | HCR_EL2_FMO;
+    r->gic.ich_hcr_el2 = ICH_HCR_EL2_EN;
+}
+
+/* vgic_lr_cpu_teardown - Returns the physical CPU interface of the current
+ *                        CPU to the state before vgic_lr_cpu_setup()
+ *  @c : current CPU
+ *
+ * A priority mask raised while the vCPU ran, by an interrupt delegated to
+ * another VM, is kept if it is stricter than the one being restored.
+ */
+static void
+vgic_lr_cpu_teardown(struct cpu *c)
+{
+    struct vgic_lr_cpu *s = &vgic_lr_cpus[cpu_index(c)];  /* saved state */
+    uint8_t            pmr;                                /* current PMR */
+
+    write_msr(ICC_CTLR_EL1, s->ctlr);
+
+    pmr = plat_interrupts_get_priority_mask();
+    plat_interrupts_set_priority_mask(pmr < s->pmr ? pmr : s->pmr);
+    isb();
+}
+
+/* vgic_lr_save - Saves the virtual CPU interface state of a vCPU
+ *  @vcpu : vCPU being switched out
+ *
+ * ICH_HCR_EL2 is saved by the exception vector together with ICC_SRE_EL2.
+ * The physical CPU interface is handed back to whatever runs next.
+ */
+HOT_TEXT void
+vgic_lr_save(struct vcpu *vcpu)
+{
+    struct arch_regs *r = &vcpu->regs;  /* register save area */
+    uint32_t         nr;                /* number of list registers */
+
+    if (!vgic_lr_enabled(vcpu))
+        return;
+
+    nr = vgic_lr_count();
+    for (uint32_t n = 0; n < nr; ++n)
+        r->gic.ich_lr_el2[n] = ich_lr_read(n);
+
+    r->gic.ich_vmcr_el2 = read_msr(ich_vmcr_el2);
+
+    switch (vgic_lr_apr_count()) {
+    case 4:
+        r->gic.ich_ap0r_el2[3] = read_msr(ich_ap0r3_el2);
+        r->gic.ich_ap0r_el2[2] = read_msr(ich_ap0r2_el2);
+        r->gic.ich_ap1r_el2[3] = read_msr(ich_ap1r3_el2);
+        r->gic.ich_ap1r_el2[2] = read_msr(ich_ap1r2_el2);
+        /* fallthrough */
+    case 2:
+        r->gic.ich_ap0r_el2[1] = read_msr(ich_ap0r1_el2);
+        r->gic.ich_ap1r_el2[1] = read_msr(ich_ap1r1_el2);
+        /* fallthrough */
+    default:
+        r->gic.ich_ap0r_el2[0] = read_msr(ich_ap0r0_el2);
+        r->gic.ich_ap1r_el2[0] = read_msr(ich_ap1r0_el2);
+    }
+
+    vgic_lr_cpu_teardown(vcpu->cpu);
+}
+
+/* vgic_lr_cpu_setup - Prepares the physical CPU interface of the current CPU
+ *  @c : current CPU
+ *
+ * While a vCPU with list registers runs, the physical CPU interface belongs
+ * to the hypervisor: all priorities are unmasked, the maintenance interrupt
+ * and the kick SGI are enabled, and priority drop and deactivation are split
+ * so that the guest can deactivate hardware-mapped interrupts itself. The
+ * previous ICC_CTLR_EL1 and priority mask are saved for
+ * vgic_lr_cpu_teardown(), as vCPUs without list registers rely on EOI also
+ * deactivating and on the masks of delegated interrupts.
+ */
+static void
+vgic_lr_cpu_setup(struct cpu *c)
+{
+    struct interrupt_descriptor maintenance = {
+        .interrupt_id          = VGIC_LR_MAINTENANCE_INTID,
+        .type_config_sec_state = INT_DESC_TYPE_PPI << 2,
+        .priority              = VGIC_LR_MAINTENANCE_PRIORITY,
+        .valid                 = true,
+    };
+    struct interrupt_descriptor kick = {
+        .interrupt_id          = VGIC_LR_KICK_SGI,
+        .type_config_sec_state = INT_DESC_TYPE_SGI << 2,
+        .priority              = VGIC_LR_MAINTENANCE_PRIORITY,
+        .valid                 = true,
+    };
+    struct vgic_lr_cpu *s = &vgic_lr_cpus[cpu_index(c)];  /* saved state */
+
+    s->ctlr = read_msr(ICC_CTLR_EL1);
+    s->pmr  = plat_interrupts_get_priority_mask();
+
+    if (!(s->ctlr & ICC_CTLR_EL1_EOIMODE))
+        write_msr(ICC_CTLR_EL1, s->ctlr | ICC_CTLR_EL1_EOIMODE);
+
+    plat_interrupts_set_priority_mask(0xff);
+    write_msr(ICC_IGRPEN1_EL1, 1);
+    isb();
+
+    if (!s->ready) {
+        plat_interrupts_configure_interrupt(maintenance);
+        plat_interrupts_configure_interrupt(kick);
+        s->ready = true;
+    }
+}
+
+/* vgic_lr_restore - Loads the virtual CPU interface state of a vCPU
+ *  @vcpu : vCPU being switched in
+ *
+ * ICH_HCR_EL2 is restored afterwards by the exception vector, which enables
+ * the virtual CPU interface with the list registers already in place.
+ */
+HOT_TEXT void
+vgic_lr_restore(struct vcpu *vcpu)
+{
+    struct arch_regs *r = &vcpu->regs;  /* register save area */
+    uint32_t         nr;                /* number of list registers */
+
+    if (!vgic_lr_enabled(vcpu))
+        return;
+
+    vgic_lr_cpu_setup(vcpu->cpu);
+
+    nr = vgic_lr_count();
+    for (uint32_t n = 0; n < nr; ++n)
+        ich_lr_write(n, r->gic.ich_lr_el2[n]);
+
+    write_msr(ich_vmcr_el2, r->gic.ich_vmcr_el2);
+
+    switch (vgic_lr_apr_count()) {
+    case 4:
+        write_msr(ich_ap0r3_el2, r->gic.ich_ap0r_el2[3]);
+        write_msr(ich_ap0r2_el2, r->gic.ich_ap0r_el2[2]);
+        write_msr(ich_ap1r3_el2, r->gic.ich_ap1r_el2[3]);
+        write_msr(ich_ap1r2_el2, r->gic.ich_ap1r_el2[2]);
+        /* fallthrough */
+    case 2:
+        write_msr(ich_ap0r1_el2, r->gic.ich_ap0r_el2[1]);
+        write_msr(ich_ap1r1_el2, r->gic.ich_ap1r_el2[1]);
+        /* fallthrough */
+    default:
+        write_msr(ich_ap0r0_el2, r->gic.ich_ap0r_el2[0]);
+        write_msr(ich_ap1r0_el2, r->gic.ich_ap1r_el2[0]);
+    }
+}
+
+/* vgic_lr_list_held - Lists held interrupts with the HW bit set
+ *  @current : vCPU whose list registers are loaded in the CPU
+ *  @empty   : bitmap of empty list registers, updated
+ *
+ *  @return : true if all held interrupts have been listed
+ */
+static bool
+vgic_lr_list_held(struct vcpu *current, uint32_t *empty)
+{
+    uint32_t *held = current->regs.gic.hw_held;  /* held bitmap      */
+    uint32_t bit;                                /* bit of the INTID */
+    uint32_t n;                                  /* list register    */
+
+    for (uint32_t i = 0;
+         i < VGIC_LR_HELD_WORDS && current->regs.gic.hw_held_count; ++i) {
+        while (held[i]) {
+            if (!*empty)
+                return false;
+
+            bit     = ctz(held[i]);
+            n       = ctz(*empty);
+            *empty &= ~(1U << n);
+
+            ich_lr_write(n, vgic_lr_hw_value(current,
+                                             i * INTERRUPT_REGISTER_BITS
+                                             + bit));
+
+            held[i] &= ~(1U << bit);
+            current->regs.gic.hw_held_count--;
+        }
+    }
+
+    return true;
+}
+
+/* vgic_lr_flush - Moves pending virtual interrupts into the list registers
+ *  @vcpu : vCPU the interrupts are pending for
+ *  @live : whether the vCPU's GIC state is loaded in the CPU; otherwise the
+ *          saved copy, which is loaded when the vCPU is switched in, is used
+ *
+ * An interrupt that is already listed is made pending again in its list
+ * register, unless it is hardware-mapped and thus follows the physical one.
+ * Interrupts that do not fit stay pending in the bitmaps and the underflow
+ * maintenance interrupt is requested to retry once the guest has drained the
+ * list registers. On the vCPU's own CPU, held interrupts are listed after
+ * the software interrupts.
+ */
+HOT_TEXT void
+vgic_lr_flush(struct vcpu *vcpu, bool live)
+{
+    struct interrupts  *irqs = &vcpu->interrupts;  /* bitmaps & counters */
+    struct vcpu_locked vcpu_locked;  /* lock on the interrupt state      */
+    uint32_t           nr;           /* number of list registers         */
+    uint32_t           empty;        /* bitmap of empty list registers   */
+    uint32_t           i;            /* bitmap word of current interrupt */
+    uint32_t           mask;         /* bit of current interrupt         */
+    uint32_t           intid;        /* current interrupt                */
+    uint32_t           n;            /* list register of the interrupt   */
+    uint64_t           lr;           /* new list register value          */
+    bool               is_irq;       /* interrupt type                   */
+    bool               overflow;     /* interrupts left in the bitmaps   */
+
+    if (vcpu_interrupt_irq_count_read(vcpu) == 0
+    &&  vcpu_interrupt_fiq_count_read(vcpu) == 0
+    &&  !(live && vcpu->regs.gic.hw_held_count))
+        return;
+
+    nr       = vgic_lr_count();
+    empty    = vgic_lr_empty(vcpu, live, nr);
+    overflow = false;
+
+    vcpu_locked = vcpu_lock(vcpu);
+
+    /* highest priority first, so that an overflow leaves the lowest behind */
+    while ((intid = vcpu_interrupt_next(vcpu_locked)) != PG_INVALID_INTID) {
+        i      = intid / INTERRUPT_REGISTER_BITS;
+        mask   = 1U << (intid % INTERRUPT_REGISTER_BITS);
+        is_irq = vgic_lr_is_irq(vcpu, intid);
+
+        n = vgic_lr_find(vcpu, live, nr, empty, intid);
+        if (n < nr) {
+            lr = vgic_lr_get(vcpu, live, n);
+            if (!(lr & ICH_LR_EL2_HW))
+                lr |= ICH_LR_EL2_STATE_PENDING;
+        } else if (empty) {
+            n      = ctz(empty);
+            empty &= ~(1U << n);
+            lr     = intid
+                   | (vgic_lr_priority(vcpu, intid)
+                      << ICH_LR_EL2_PRIORITY_SHIFT)
+                   | (is_irq ? ICH_LR_EL2_GROUP1 : 0)
+                   | ICH_LR_EL2_STATE_PENDING;
+        } else {
+            overflow = true;
+            break;
+        }
+
+        vgic_lr_set(vcpu, live, n, lr);
+
+        atomic_fetch_and_explicit(&irqs->interrupt_pending[i], ~mask,
+                                  memory_order_relaxed);
+        vcpu_interrupt_summary_update(vcpu_locked, intid);
+        if (is_irq)
+            vcpu_irq_count_decrement(vcpu_locked);
+        else
+            vcpu_fiq_count_decrement(vcpu_locked);
+    }
+
+    vcpu_unlock(&vcpu_locked);
+
+    if (live && !overflow)
+        overflow = !vgic_lr_list_held(vcpu, &empty);
+
+    vgic_lr_set_uie(vcpu, live, overflow);
+}
+
+/* vgic_lr_pending - Checks for listed interrupts the guest has yet to take
+ *  @vcpu : current vCPU, whose list registers are loaded in the CPU
+ *
+ *  @return : true if a list register holds a pending interrupt or a held one
+ *            is waiting for one
+ */
+HOT_TEXT bool
+vgic_lr_pending(struct vcpu *vcpu)
+{
+    uint32_t nr;     /* number of list registers        */
+    uint32_t empty;  /* bitmap of empty list registers  */
+
+    if (!vgic_lr_enabled(vcpu))
+        return false;
+
+    if (vcpu->regs.gic.hw_held_count)
+        return true;
+
+    nr    = vgic_lr_count();
+    empty = vgic_lr_empty(vcpu, true, nr);
+
+    for (uint32_t n = 0; n < nr; ++n)
+        if (!(empty & (1U << n))
+        &&  (ich_lr_read(n) & ICH_LR_EL2_STATE_PENDING))
+            return true;
+
+    return false;
+}
+
+/* vgic_lr_owns - Checks whether a VM owns a shared peripheral interrupt
+ *  @vm    : VM in question
+ *  @intid : physical interrupt ID
+ *
+ *  @return : true if the interrupt is assigned to the VM in its manifest
+ */
+static bool
+vgic_lr_owns(const struct vm *vm, uint32_t intid)
+{
+    for (uint32_t i = 0; i < VM_MANIFEST_MAX_INTERRUPTS; ++i) {
+        /* descriptors are populated contiguously */
+        if (!vm->interrupt_desc[i].valid)
+            break;
+
+        if (vm->interrupt_desc[i].interrupt_id == intid)
+            return true;
+    }
+
+    return false;
+}
+
+/* vgic_lr_set_pending - Makes a virtual interrupt pending
+ *  @vcpu_locked : target vCPU
+ *  @intid       : virtual interrupt ID
+ *
+ * Unlike api_interrupt_inject_locked(), this also marks the interrupt as
+ * enabled: the guest controls enabling through the distributor, so whatever
+ * reaches the hypervisor is to be delivered. Only used for SGIs, which the
+ * interrupt bitmaps always cover.
+ */
+static void
+vgic_lr_set_pending(struct vcpu_locked vcpu_locked, uint32_t intid)
+{
+    struct interrupts *irqs  = &vcpu_locked.vcpu->interrupts;
+    uint32_t          index  = intid / INTERRUPT_REGISTER_BITS;
+    uint32_t          mask   = 1U << (intid % INTERRUPT_REGISTER_BITS);
+    uint32_t          enabled;  /* enable bits before the update  */
+    uint32_t          pending;  /* pending bits before the update */
+
+    enabled = atomic_fetch_or_explicit(&irqs->interrupt_enabled[index], mask,
+                                       memory_order_relaxed);
+    pending = atomic_fetch_or_explicit(&irqs->interrupt_pending[index], mask,
+                                       memory_order_relaxed);
+
+    /* the count follows the pending bit, see struct interrupts */
+    if (enabled & pending & mask)
+        return;
+
+    vcpu_interrupt_summary_update(vcpu_locked, intid);
+
+    if (irqs->interrupt_type[index] & mask)
+        vcpu_fiq_count_increment(vcpu_locked);
+    else
+        vcpu_irq_count_increment(vcpu_locked);
+}
+
+/* vgic_lr_complete - Completes a physical interrupt handled in EL2
+ *  @intid : acknowledged physical interrupt ID
+ */
+static void
+vgic_lr_complete(uint32_t intid)
+{
+    plat_interrupts_end_of_interrupt(intid);
+    plat_interrupts_deactivate(intid);
+}
+
+/* vgic_lr_list_hw - Lists a physical PPI or SPI for the guest to complete
+ *  @current : vCPU that owns the interrupt, running on the current CPU
+ *  @intid   : acknowledged physical interrupt ID
+ *
+ * The list register points at the physical interrupt, which stays active
+ * until the guest's virtual EOI (or DIR) deactivates it. The GIC does not
+ * signal it again in the meantime, so the hypervisor is entered once per
+ * interrupt and never on its completion, and a level-triggered line cannot
+ * fire again before the guest has handled it. Without a free list register
+ * the interrupt is held, still active, until vgic_lr_flush() finds one.
+ *
+ * The deactivation of an SPI is handled by the distributor, so it does not
+ * matter on which CPU the guest eventually performs it. A PPI is banked in
+ * the redistributor of this CPU, to which the vCPU is pinned.
+ */
+static void
+vgic_lr_list_hw(struct vcpu *current, uint32_t intid)
+{
+    struct arch_regs *r = &current->regs;  /* register save area         */
+    uint32_t         index = intid / INTERRUPT_REGISTER_BITS;
+    uint32_t         mask  = 1U << (intid % INTERRUPT_REGISTER_BITS);
+    uint32_t         empty;  /* bitmap of empty list registers */
+
+    /* drop the running priority; deactivation is left to the guest */
+    plat_interrupts_end_of_interrupt(intid);
+
+    empty = vgic_lr_empty(current, true, vgic_lr_count());
+    if (empty && !r->gic.hw_held_count) {
+        ich_lr_write(ctz(empty), vgic_lr_hw_value(current, intid));
+        return;
+    }
+
+    if (!(r->gic.hw_held[index] & mask)) {
+        r->gic.hw_held[index] |= mask;
+        r->gic.hw_held_count++;
+    }
+
+    vgic_lr_flush(current, true);
+}
+
+/* vgic_lr_handle_interrupt - Handles a physical interrupt taken from a vCPU
+ *                            with list registers
+ *  @current : vCPU that was interrupted
+ *  @intid   : acknowledged physical interrupt ID
+ *
+ *  @return : true if the interrupt has been handled; false if it belongs to
+ *            another VM and must be delegated
+ *
+ * SGIs, PPIs and the VM's own SPIs are listed for the current vCPU. PPIs and
+ * SPIs are always hardware-mapped, see vgic_lr_list_hw(), as a level-sensitive
+ * source such as the virtual timer would otherwise fire again before the
+ * guest has handled it. SGIs are edge-triggered; they are completed
+ * immediately and listed in software.
+ */
+HOT_TEXT bool
+vgic_lr_handle_interrupt(struct vcpu *current, uint32_t intid)
+{
+    struct vcpu_locked vcpu_locked;  /* lock on the interrupt state */
+
+    if (intid >= VGIC_LR_SPECIAL_BASE)
+        return true;
+
+    if (intid == VGIC_LR_KICK_SGI) {
+        /* interrupts were made pending from another CPU */
+        vgic_lr_complete(intid);
+        vgic_lr_flush(current, true);
+        return true;
+    }
+
+    if (intid == VGIC_LR_MAINTENANCE_INTID) {
+        /* the condition is level sensitive; clear it before the EOI */
+        vgic_lr_set_uie(current, true, false);
+        isb();
+        vgic_lr_complete(intid);
+        vgic_lr_flush(current, true);
+        return true;
+    }
+
+    if (intid >= VGIC_LR_SPI_BASE && !vgic_lr_owns(current->vm, intid))
+        return false;
+
+    if (intid >= VGIC_LR_PPI_BASE) {
+        vgic_lr_list_hw(current, intid);
+        return true;
+    }
+
+    vcpu_locked = vcpu_lock(current);
+    vgic_lr_set_pending(vcpu_locked, intid);
+    vcpu_unlock(&vcpu_locked);
+
+    vgic_lr_complete(intid);
+    vgic_lr_flush(current, true);
+
+    return true;
+}
+
+/* vgic_lr_kick - Makes another CPU refresh the list registers of its vCPU
+ *  @c : CPU running a vCPU with list registers
+ *
+ * The reserved SGI is taken to EL2 on the target CPU and handled by
+ * vgic_lr_handle_interrupt(), which moves the interrupts made pending since
+ * into the live list registers. A vCPU idling in EL2 is woken up by the SGI
+ * as well, since a pending interrupt ends WFI even while it is masked.
+ */
+void
+vgic_lr_kick(const struct cpu *c)
+{
+    /* make the pending bits and counters visible before the SGI */
+    dsb(ishst);
+    write_msr(ICC_SGI1R_EL1, icc_sgi1r_route(c->id)
+                             | ((uint64_t) VGIC_LR_KICK_SGI
+                                << ICC_SGI1R_EL1_INTID_SHIFT));
+    isb();
+}
+
+#endif /* GIC_VERSION == 3 || GIC_VERSION == 4 */
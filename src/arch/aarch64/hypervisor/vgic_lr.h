@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/cpu.h"
+#include "pg/vm.h"
+
+/**
+ * GICv3 list register based virtual interrupt delivery, enabled per VM with
+ * the "vgic_list_registers" manifest property.
+ *
+ * Physical interrupts of such VMs are taken to EL2 (HCR_EL2.IMO/FMO), which
+ * also redirects the guest's ICC_* accesses to the virtual CPU interface.
+ * Pending virtual interrupts are moved from the vCPU's interrupt bitmaps into
+ * the ICH_LR<n>_EL2 registers, from where the guest acknowledges and
+ * completes them without trapping. Interrupts that do not fit wait in the
+ * bitmaps until the list registers drain, which is signalled by the
+ * underflow maintenance interrupt. Physical PPIs, such as the virtual timer,
+ * and the VM's SPIs bypass the bitmaps: they are listed with the HW bit set
+ * and stay active in the GIC, if need be while waiting for a list register,
+ * until the guest deactivates them.
+ */
+
+#if GIC_VERSION == 3 || GIC_VERSION == 4
+
+/** PPI raised by the virtual CPU interface for maintenance events. */
+#define VGIC_LR_MAINTENANCE_INTID 25
+
+/**
+ * Priority of listed interrupts that have no priority in the vCPU's interrupt
+ * state, i.e. SPIs beyond PG_NUM_INTIDS.
+ */
+#define VGIC_LR_DEFAULT_PRIORITY 0xa0
+
+/**
+ * SGI reserved for the hypervisor to make another CPU refresh the list
+ * registers of the vCPU it runs. Guests using list registers cannot send it.
+ */
+#define VGIC_LR_KICK_SGI 15
+
+static inline bool vgic_lr_enabled(const struct vcpu *vcpu)
+{
+	return vcpu->vm->vgic_lr;
+}
+
+void vgic_lr_regs_reset(struct vcpu *vcpu);
+void vgic_lr_save(struct vcpu *vcpu);
+void vgic_lr_restore(struct vcpu *vcpu);
+void vgic_lr_flush(struct vcpu *vcpu, bool live);
+bool vgic_lr_pending(struct vcpu *vcpu);
+bool vgic_lr_handle_interrupt(struct vcpu *current, uint32_t intid);
+void vgic_lr_kick(const struct cpu *c);
+
+#else
+
+static inline bool vgic_lr_enabled(const struct vcpu *vcpu)
+{
+	(void)vcpu;
+	return false;
+}
+
+static inline void vgic_lr_regs_reset(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+static inline void vgic_lr_save(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+static inline void vgic_lr_restore(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+static inline void vgic_lr_flush(struct vcpu *vcpu, bool live)
+{
+	(void)vcpu;
+	(void)live;
+}
+
+static inline bool vgic_lr_pending(struct vcpu *vcpu)
+{
+	(void)vcpu;
+	return false;
+}
+
+static inline bool vgic_lr_handle_interrupt(struct vcpu *current,
+					    uint32_t intid)
+{
+	(void)current;
+	(void)intid;
+	return false;
+}
+
+static inline void vgic_lr_kick(const struct cpu *c)
+{
+	(void)c;
+}
+
+#endif /* GIC_VERSION == 3 || GIC_VERSION == 4 */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#pragma once
+
+/**
+ * Sequence lock for read-mostly data.
+ *
+ * Writers serialize on an embedded spinlock and make the sequence number odd
+ * for the duration of the update. Readers never write to the lock: they take a
+ * snapshot of the protected data between seq_read_begin() and seq_read_retry()
+ * and start over if a writer was active in the meantime. Readers must only
+ * copy the protected data (no pointer chasing into memory that a writer may
+ * free) and act on the copy once seq_read_retry() returned false.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pg/arch/barriers.h"
+#include "pg/arch/spinlock.h"
+
+struct seqlock {
+	volatile uint32_t seq;
+	struct spinlock writer;
+};
+
+#define SEQLOCK_INIT ((struct seqlock){.seq = 0, .writer = SPINLOCK_INIT})
+
+static inline void seq_init(struct seqlock *s)
+{
+	*s = SEQLOCK_INIT;
+}
+
+static inline uint32_t seq_read_begin(const struct seqlock *s)
+{
+	uint32_t seq;
+
+	/* Wait for a concurrent writer to finish. */
+	while ((seq = s->seq) & 1) {
+		__asm__ volatile("yield");
+	}
+
+	/* Order the sequence read before the reads of the protected data. */
+	dmb(ishld);
+
+	return seq;
+}
+
+static inline bool seq_read_retry(const struct seqlock *s, uint32_t start)
+{
+	/* Order the reads of the protected data before the sequence re-read. */
+	dmb(ishld);
+
+	return s->seq != start;
+}
+
+static inline void seq_write_lock(struct seqlock *s)
+{
+	sl_lock(&s->writer);
+	s->seq++;
+
+	/* Publish the odd sequence number before any data is modified. */
+	dmb(ishst);
+}
+
+static inline void seq_write_unlock(struct seqlock *s)
+{
+	/* Publish the modified data before the even sequence number. */
+	dmb(ishst);
+	s->seq++;
+	sl_unlock(&s->writer);
+}
@@ -24,8 +24,24 @@
 
 #include "pg/arch/types.h"
 
+/*
+ * Contention profiling is only available in the hypervisor image; test VMs
+ * share this header but do not link the statistics collector.
+ */
+#if defined(LOCK_STATS) && LOCK_STATS && !VM_TOOLCHAIN
+#define SL_PROFILING 1
+#include "pg/lock_stats.h"
+#else
+#define SL_PROFILING 0
+#endif
+
 struct spinlock {
 	volatile uint32_t v;
+#if SL_PROFILING
+	/* Owned by the lock holder. */
+	uint64_t acquired_at;
+	struct lock_stats_entry *stats;
+#endif
 };
 
 #define SPINLOCK_INIT ((struct spinlock){.v = 0})
@@ -35,6 +51,61 @@ static inline void sl_init(struct spinlock *l)
 	*l = SPINLOCK_INIT;
 }
 
+#if SL_PROFILING
+
+static inline uint64_t sl_now(void)
+{
+	uint64_t t;
+
+	__asm__ volatile("mrs %0, cntpct_el0" : "=r"(t));
+	return t;
+}
+
+/**
+ * Same as sl_lock() but also counts the number of times the CPU had to wait
+ * for the lock and accounts the acquisition to the given site and caller.
+ */
+static inline void sl_lock_profiled(struct spinlock *l,
+				    const struct lock_stats_site *site,
+				    uintptr_t caller)
+{
+	register uintreg_t tmp1;
+	register uintreg_t tmp2;
+	uint64_t spins = 0;
+	uint64_t start = sl_now();
+	uint64_t now;
+
+	__asm__ volatile(
+		"	mov	%w2, #1\n"
+		"	sevl\n"
+		"1:	wfe\n"
+		"	add	%3, %3, #1\n"	  /* count waits (+1 for SEVL) */
+		"2:	ldaxr	%w1, [%4]\n"
+		"	cbnz	%w1, 1b\n"
+		"	stxr	%w1, %w2, [%4]\n"
+		"	cbnz	%w1, 2b\n"
+		: "+m"(*l), "=&r"(tmp1), "=&r"(tmp2), "+r"(spins)
+		: "r"(l)
+		: "cc");
+
+	now = sl_now();
+	l->stats = lock_stats_acquired(site, caller, spins - 1, now - start);
+	l->acquired_at = now;
+}
+
+/*
+ * Every expansion of sl_lock() gets its own static site descriptor. The return
+ * address distinguishes the callers of lock wrappers (e.g. vcpu_lock()).
+ */
+#define sl_lock(l)                                                          \
+	do {                                                                \
+		static const struct lock_stats_site sl_site_ = {            \
+			.name = #l, .file = __FILE__, .line = __LINE__};    \
+		sl_lock_profiled((l), &sl_site_,                            \
+				 (uintptr_t)__builtin_return_address(0));   \
+	} while (0)
+
+#else
 
 static inline void sl_lock(struct spinlock *l)
 {
@@ -59,11 +130,23 @@ static inline void sl_lock(struct spinlock *l)
 		: "cc");
 }
 
+#endif /* SL_PROFILING */
+
 static inline void sl_unlock(struct spinlock *l)
 {
+#if SL_PROFILING
+	/* Must be sampled before the lock is handed over. */
+	struct lock_stats_entry *stats = l->stats;
+	uint64_t hold = sl_now() - l->acquired_at;
+
+#endif
 	/*
 	 * Store zero to lock's value with release semantics. This triggers an
 	 * event which wakes up other threads waiting on a lock (no SEV needed).
 	 */
 	__asm__ volatile("stlr wzr, [%1]" : "=m"(*l) : "r"(l) : "cc");
+
+#if SL_PROFILING
+	lock_stats_released(stats, hold);
+#endif
 }
@@ -16,6 +16,7 @@
 #define PAGE_BITS 12
 #define PAGE_LEVEL_BITS 9
 #define STACK_ALIGN 16
+#define CACHE_LINE_SIZE 64
 #define FLOAT_REG_BYTES 16
 #define NUM_GP_REGS 31
 #define PAGE_BITS_MASK ((1 << PAGE_BITS) - 1)
@@ -76,6 +77,8 @@ struct arch_vm {
 	} tid3_masks;
 };
 
+struct cpu;
+
 /** Type to represent the register state of a vCPU. */
 struct arch_regs {
 	/* General purpose registers. */
@@ -134,10 +137,35 @@ struct arch_regs {
 	uintreg_t fpsr;
 	uintreg_t fpcr;
 
+	/*
+	 * Physical CPU that last loaded the floating point registers above, or
+	 * NULL if they have not been loaded since they were last written.
+	 * Maintained by the lazy FP/SIMD switching in fpsimd.c.
+	 */
+	const struct cpu *fp_cpu;
+
 #if GIC_VERSION == 3 || GIC_VERSION == 4
 	struct {
 		uintreg_t ich_hcr_el2;
 		uintreg_t icc_sre_el2;
+
+		/*
+		 * Virtual CPU interface state, only used by VMs that receive
+		 * interrupts through list registers. See vgic_lr.c.
+		 */
+		uintreg_t ich_vmcr_el2;
+		uintreg_t ich_ap0r_el2[4];
+		uintreg_t ich_ap1r_el2[4];
+		uintreg_t ich_lr_el2[16];
+
+		/*
+		 * Physical PPIs and SPIs taken for the vCPU that are kept active
+		 * until a free list register hands their deactivation to the
+		 * guest, one bit per INTID below 1024. Only accessed on the CPU
+		 * that runs the vCPU. See vgic_lr.c.
+		 */
+		uint32_t hw_held[32];
+		uint32_t hw_held_count;
 	} gic;
 #endif
 
@@ -24,3 +24,9 @@ static inline void timer_start(void)
 	has_vhe_support() ? write_msr(MSR_CNTV_CTL_EL02, 0x00000001)
 			  : write_msr(cntv_ctl_el0, 0x00000001);
 }
+
+static inline void timer_stop(void)
+{
+	has_vhe_support() ? write_msr(MSR_CNTV_CTL_EL02, 0x00000000)
+			  : write_msr(cntv_ctl_el0, 0x00000000);
+}
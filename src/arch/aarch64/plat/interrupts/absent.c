@@ -51,6 +51,16 @@ void plat_interrupts_set_priority_mask(uint8_t min_priority)
 	(void)min_priority;
 }
 
+uint8_t plat_interrupts_get_priority_mask(void)
+{
+	return 0xff;
+}
+
+uint8_t plat_interrupts_get_running_priority(void)
+{
+	return 0xff;
+}
+
 /* New: */
 void plat_interrupts_set_priority(uint32_t id, uint32_t core_pos,
 				  uint32_t priority)
@@ -88,6 +98,11 @@ void plat_interrupts_end_of_interrupt(uint32_t id)
 	(void)id;
 }
 
+void plat_interrupts_deactivate(uint32_t id)
+{
+	(void)id;
+}
+
 void plat_interrupts_configure_interrupt(struct interrupt_descriptor int_desc)
 {
 	(void)int_desc;
@@ -303,6 +303,18 @@
  	write_msr(ICC_EOIR1_EL1, id);
  }
 
+ /**
+  * Deactivates an interrupt whose priority has already been dropped by
+  * gicv3_end_of_interrupt(). With ICC_CTLR_EL1.EOImode clear, the EOI has
+  * deactivated it already and there is nothing left to do.
+  */
+ void gicv3_deactivate_interrupt(uint32_t id)
+ {
+ 	if (read_msr(ICC_CTLR_EL1) & ICC_CTLR_EOIMODE_BIT) {
+ 		write_msr(ICC_DIR_EL1, id);
+ 	}
+ }
+
  uint64_t read_gicr_typer_reg(uintptr_t gicr_frame_addr)
  {
  	return io_read64(IO64_C(gicr_frame_addr + GICR_TYPER));
@@ -508,6 +520,20 @@ void plat_interrupts_set_priority_mask(uint8_t min_priority)
 {
 	write_msr(ICC_PMR_EL1, min_priority);
 }
+
+uint8_t plat_interrupts_get_priority_mask(void)
+{
+	return read_msr(ICC_PMR_EL1) & 0xff;
+}
+
+/**
+ * Returns the priority of the highest-priority active interrupt whose
+ * priority has not been dropped yet, or 0xff if there is none.
+ */
+uint8_t plat_interrupts_get_running_priority(void)
+{
+	return read_msr(ICC_RPR_EL1) & 0xff;
+}
  /* New: */
  void plat_interrupts_set_priority(uint32_t id, uint32_t core_pos,
  				  uint32_t priority)
@@ -545,6 +571,11 @@ void plat_interrupts_set_priority_mask(uint8_t min_priority)
  	gicv3_end_of_interrupt(id);
  }
 
+ void plat_interrupts_deactivate(uint32_t id)
+ {
+ 	gicv3_deactivate_interrupt(id);
+ }
+
  /**
   * Configure Group, priority, edge/level of the interrupt and enable it.
   */
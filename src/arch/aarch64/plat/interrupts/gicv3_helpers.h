@@ -195,6 +195,9 @@
 #define ICC_SRE_DFB_BIT BIT_32(1)
 #define ICC_SRE_SRE_BIT BIT_32(0)
 
+/* ICC_CTLR bit definitions */
+#define ICC_CTLR_EOIMODE_BIT BIT_32(1)
+
 /* ICC_IGRPEN1_EL3 bit definitions */
 #define IGRPEN1_EL3_ENABLE_G1NS_SHIFT 0
 #define IGRPEN1_EL3_ENABLE_G1S_SHIFT 1
@@ -94,6 +94,16 @@
  * See Arm Architecture Reference Manual Armv8-A, D13.2.36 and D13.2.37.
  */
 
+/**
+ * Hypervisor Fault Address Register Non-Secure.
+ */
+#define HPFAR_EL2_NS (UINT64_C(0x1) << 63)
+
+/**
+ * Hypervisor Fault Address Register Faulting IPA.
+ */
+#define HPFAR_EL2_FIPA (UINT64_C(0xFFFFFFFFFF0))
+
 /**
  * Offset for the Exception Class (EC) field in the ESR.
  */
@@ -119,6 +129,12 @@
  */
 #define EC_WFI_WFE UINT64_C(0x1)
 
+/**
+ * ESR code for an access to SIMD or floating-point registers trapped by
+ * CPTR_EL2.TFP or CPTR_EL2.FPEN.
+ */
+#define EC_FP_SIMD UINT64_C(0x7)
+
 /**
  * ESR code for HVC instruction execution.
  */
@@ -491,6 +507,93 @@
  */
 #define CPTR_EL2_VHE_FPEN (UINT64_C(0x3) << 20)
 
+/**
+ * Trap accesses to SIMD and floating point registers from all exception levels
+ * (HCR_EL2.E2H=0). With HCR_EL2.E2H=1 the same is achieved by clearing
+ * CPTR_EL2.FPEN.
+ */
+#define CPTR_EL2_TFP (UINT64_C(0x1) << 10)
+
+/**
+ * Affinity fields of MPIDR_EL1, which make up the ID of the physical CPU.
+ */
+#define MPIDR_EL1_AFFINITY_MASK UINT64_C(0xff00ffffff)
+
+/**
+ * Pending physical IRQ and FIQ, as reported by ISR_EL1.
+ */
+#define ISR_EL1_I (UINT64_C(0x1) << 7)
+#define ISR_EL1_F (UINT64_C(0x1) << 6)
+
+/**
+ * GICv3 virtual CPU interface control (ICH_HCR_EL2).
+ * EN enables the virtual CPU interface, UIE raises a maintenance interrupt
+ * when at most one list register holds a valid interrupt.
+ */
+#define ICH_HCR_EL2_EN (UINT64_C(0x1) << 0)
+#define ICH_HCR_EL2_UIE (UINT64_C(0x1) << 1)
+
+/**
+ * Number of implemented list registers and preemption bits, minus one, as
+ * reported by ICH_VTR_EL2.
+ */
+#define ICH_VTR_EL2_LIST_REGS_MASK UINT64_C(0x1f)
+#define ICH_VTR_EL2_PRE_BITS_SHIFT 26
+#define ICH_VTR_EL2_PRE_BITS_MASK UINT64_C(0x7)
+
+/**
+ * GICv3 list register (ICH_LR<n>_EL2) fields.
+ */
+#define ICH_LR_EL2_VINTID_MASK UINT64_C(0xffffffff)
+#define ICH_LR_EL2_PINTID_SHIFT 32
+#define ICH_LR_EL2_PRIORITY_SHIFT 48
+#define ICH_LR_EL2_GROUP1 (UINT64_C(0x1) << 60)
+#define ICH_LR_EL2_HW (UINT64_C(0x1) << 61)
+#define ICH_LR_EL2_STATE_PENDING (UINT64_C(0x1) << 62)
+#define ICH_LR_EL2_STATE_ACTIVE (UINT64_C(0x1) << 63)
+#define ICH_LR_EL2_STATE_MASK \
+	(ICH_LR_EL2_STATE_PENDING | ICH_LR_EL2_STATE_ACTIVE)
+
+/**
+ * GICv3 SGI generation register (ICC_SGI1R_EL1) fields. A target is selected
+ * by Aff3.Aff2.Aff1, RS (Aff0 / 16) and bit Aff0 % 16 of the target list.
+ */
+#define ICC_SGI1R_EL1_TARGET_LIST_MASK UINT64_C(0xffff)
+#define ICC_SGI1R_EL1_AFF1_SHIFT 16
+#define ICC_SGI1R_EL1_INTID_SHIFT 24
+#define ICC_SGI1R_EL1_INTID_MASK (UINT64_C(0xf) << ICC_SGI1R_EL1_INTID_SHIFT)
+#define ICC_SGI1R_EL1_AFF2_SHIFT 32
+#define ICC_SGI1R_EL1_IRM (UINT64_C(0x1) << 40)
+#define ICC_SGI1R_EL1_RS_SHIFT 44
+#define ICC_SGI1R_EL1_AFF3_SHIFT 48
+#define ICC_SGI1R_EL1_ROUTE_MASK                                   \
+	((UINT64_C(0xff) << ICC_SGI1R_EL1_AFF1_SHIFT) |            \
+	 (UINT64_C(0xff) << ICC_SGI1R_EL1_AFF2_SHIFT) |            \
+	 (UINT64_C(0xf) << ICC_SGI1R_EL1_RS_SHIFT) |               \
+	 (UINT64_C(0xff) << ICC_SGI1R_EL1_AFF3_SHIFT))
+
+/**
+ * Returns the ICC_SGI1R_EL1 target fields (Aff3.Aff2.Aff1, RS and the target
+ * list bit) that select the single PE with the given MPIDR affinity.
+ */
+static inline uint64_t icc_sgi1r_route(uint64_t mpidr)
+{
+	uint64_t aff0 = mpidr & 0xff;
+
+	return ((mpidr >> 8) & 0xff) << ICC_SGI1R_EL1_AFF1_SHIFT |
+	       ((mpidr >> 16) & 0xff) << ICC_SGI1R_EL1_AFF2_SHIFT |
+	       ((mpidr >> 32) & 0xff) << ICC_SGI1R_EL1_AFF3_SHIFT |
+	       (aff0 / 16) << ICC_SGI1R_EL1_RS_SHIFT | UINT64_C(1) << (aff0 % 16);
+}
+
+/**
+ * ISS of a trapped write to ICC_SGI1R_EL1, with Rt cleared.
+ */
+#define ICC_SGI1R_EL1_WRITE_ISS (UINT64_C(0x3) << ISS_OP0_SHIFT |  \
+				 UINT64_C(0x5) << ISS_OP2_SHIFT |  \
+				 UINT64_C(0xc) << ISS_CRN_SHIFT |  \
+				 UINT64_C(0xb) << ISS_CRM_SHIFT)
+
 /*
  * Process State Bit definitions.
  *
@@ -20,9 +20,12 @@
 
 #include "pg/arch/virt_devs.h"  /* virt devices management    */
 #include "pg/arch/types.h"      /* arch-specific typedefs     */
+#include "pg/code_layout.h"    /* hot/cold text placement    */
 #include "pg/plat/console.h"    /* plat_console_{put,get}char */
 #include "pg/vcpu.h"            /* vcpu structures            */
 #include "pg/dlog.h"            /* logging                    */
+#include "pg/error.h"           /* error handling macros      */
+#include "pg/mmio.h"            /* MMIO region table          */
 
 /* APIs of supported virtual devices */
 #include "pg/arch/virt_devs/sanct_uart.h"
@@ -96,7 +99,7 @@ virt_identity_map(uint64_t                base,
  *       do both `mm_identity_map()` and `vm_identity_map()`. need to look
  *       some more into that, at some point.
  */
-int
+COLD_TEXT int
 init_backing_devs(struct mm_stage1_locked stage1_locked,
                   struct mpool            *ppool)
 {
@@ -152,7 +155,7 @@ init_backing_devs(struct mm_stage1_locked stage1_locked,
 /* init_virt_devs - initialization of virtual devices
  *  @return : 0 if everything went well; -1 otherwise
  */
-int
+COLD_TEXT int
 init_virt_devs(void)
 {
     static bool accessed = false;   /* was this function accessed previously? */
@@ -242,35 +245,45 @@ init_virt_devs(void)
     return 0;
 }
 
-/* access_virt_dev - tries to handle memory access fault by VM
+/* access_virt_dev - MMIO handler of virtual device instances
  *  @esr    : contents of ESR register (including fault reason)
  *  @far    : contents of FAR register (faulting address)
  *  @pc_inc : instruction length (if we want to increment PC)
  *  @vcpu   : vcpu that caused the fault
  *  @info   : extra information regarding the fault
+ *  @region : accessed region; ctx is the device instance
  *
  *  @return : true if handled, false otherwise
  */
-bool
-access_virt_dev(uintreg_t               esr,
-                uintreg_t               far,
-                uint8_t                 pc_inc,
-                struct vcpu             *vcpu,
-                struct vcpu_fault_info  *info)
+static HOT_TEXT bool
+access_virt_dev(uintreg_t                esr,
+                uintreg_t                far,
+                uint8_t                  pc_inc,
+                struct vcpu              *vcpu,
+                struct vcpu_fault_info   *info,
+                const struct mmio_region *region)
 {
-    struct virt_dev *dev = devs;
-
-    /* look for the device in charge of the accessed address */
-    for (size_t i = 0; i < active_devs; i++, dev++) {
-        if (info->ipaddr.ipa >= dev->addr_start
-        &&  info->ipaddr.ipa <  dev->addr_end)
-        {
-            /* search succeeded; delegate to virt device driver */
-            return dev->access(esr, far, pc_inc, vcpu, info, dev);
-        }
-    }
+    struct virt_dev *dev = region->ctx;
 
-    /* search failed; let the VM deal with this fault itself */
-    return false;
+    /* delegate to virt device driver */
+    return dev->access(esr, far, pc_inc, vcpu, info, dev);
 }
 
+/* register_virt_devs - adds all virtual device instances to an MMIO table
+ *  @table : MMIO table of the VM
+ *
+ *  @return : 0 if everything went well; -1 otherwise
+ *
+ * Must be called after init_virt_devs().
+ */
+COLD_TEXT int
+register_virt_devs(struct mmio_table *table)
+{
+    for (size_t i = 0; i < active_devs; i++) {
+        RET(!mmio_region_add(table, devs[i].addr_start, devs[i].addr_end,
+                             access_virt_dev, &devs[i]),
+            -1, "Unable to register virtual device %s\n", devs[i].name);
+    }
+
+    return 0;
+}
@@ -192,3 +192,16 @@ bool virtioac_handle(uintreg_t esr, uintreg_t far, uint8_t pc_inc, struct vcpu *
 		return false;
 	}
 }
+
+static bool virtioac_access(uintreg_t esr, uintreg_t far, uint8_t pc_inc, struct vcpu *vcpu, struct vcpu_fault_info *info, const struct mmio_region *region) {
+	(void)region;
+
+	return virtioac_handle(esr, far, pc_inc, vcpu, info);
+}
+
+/**
+ * Adds the VirtIO window to the MMIO table of a VM.
+ */
+bool virtioac_register(struct mmio_table *table) {
+	return mmio_region_add(table, VIRTIO_START, VIRTIO_END + 1, virtioac_access, NULL);
+}
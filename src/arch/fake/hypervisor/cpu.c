@@ -55,3 +55,9 @@ void arch_cpu_init(struct cpu *c, ipaddr_t entry_point)
 	(void)c;
 	(void)entry_point;
 }
+
+bool arch_vcpu_kick(struct vcpu_locked vcpu_locked)
+{
+	(void)vcpu_locked;
+	return false;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#pragma once
+
+/**
+ * Generic implementation of a sequence lock using C11 fences.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pg/arch/spinlock.h"
+
+struct seqlock {
+	volatile uint32_t seq;
+	struct spinlock writer;
+};
+
+#define SEQLOCK_INIT ((struct seqlock){.seq = 0, .writer = SPINLOCK_INIT})
+
+static inline void seq_init(struct seqlock *s)
+{
+	s->seq = 0;
+	sl_init(&s->writer);
+}
+
+static inline uint32_t seq_read_begin(const struct seqlock *s)
+{
+	uint32_t seq;
+
+	while ((seq = s->seq) & 1) {
+		/* do nothing */
+	}
+	atomic_thread_fence(memory_order_acquire);
+
+	return seq;
+}
+
+static inline bool seq_read_retry(const struct seqlock *s, uint32_t start)
+{
+	atomic_thread_fence(memory_order_acquire);
+
+	return s->seq != start;
+}
+
+static inline void seq_write_lock(struct seqlock *s)
+{
+	sl_lock(&s->writer);
+	s->seq++;
+	atomic_thread_fence(memory_order_release);
+}
+
+static inline void seq_write_unlock(struct seqlock *s)
+{
+	atomic_thread_fence(memory_order_release);
+	s->seq++;
+	sl_unlock(&s->writer);
+}
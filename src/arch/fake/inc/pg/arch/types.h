@@ -14,6 +14,7 @@
 #define PAGE_BITS 12
 #define PAGE_LEVEL_BITS 9
 #define STACK_ALIGN 64
+#define CACHE_LINE_SIZE 64
 #define CPU_ERROR_INVALID_ID 0xFFFFFFFF
 
 #define PA_BITS_MASK 0xFFFFFFFFF000 // bits 48:12 /* TODO: is there a way to dynamically calculate this? */
@@ -102,6 +102,7 @@ void cpu_module_init(const cpu_id_t *cpu_ids, size_t count)
 		c->id = id;
 		/* Mark CPUs as unassigned */
 		c->is_assigned = false;
+		c->vm = NULL;
 	}
 
 	if (!found_boot_cpu) {
@@ -152,6 +153,8 @@ bool cpu_on(struct cpu *c, ipaddr_t entry, uintreg_t arg)
 		//struct vcpu *vcpu = vm_get_vcpu(vm, cpu_index(c));
 
 		struct vm *vm = vm_find_from_cpu(c);
+        RET(!vm, prev, "CPU %#x not assigned to any VM\n", c->id);
+
         cpu_index_local = vm_local_cpu_index(c);
         RET(cpu_index_local == (uint16_t) -1, prev,
             "Unable to identify vCPU index of CPU %#x\n", c->id);
@@ -32,6 +32,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "pg/code_layout.h"
 #include "pg/spinlock.h"
 #include "pg/std.h"
 #include "pg/stdout.h"
@@ -258,7 +259,7 @@ void dlog_flush_vm_buffer(uint16_t id, char buffer[], size_t length)
 /**
  * Same as "dlog", except that arguments are passed as a va_list
  */
-void vdlog(const char *fmt, va_list args)
+COLD_TEXT void vdlog(const char *fmt, va_list args)
 {
 	const char *p;
 	size_t w;
@@ -373,7 +374,7 @@ void vdlog(const char *fmt, va_list args)
 /**
  * Prints the given format string to the debug log.
  */
-void dlog(const char *fmt, ...)
+COLD_TEXT void dlog(const char *fmt, ...)
 {
 	va_list args;
 
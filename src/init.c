@@ -38,6 +38,7 @@
 #include "pg/boot_flow.h"
 #include "pg/boot_params.h"
 #include "pg/cpio.h"
+#include "pg/code_layout.h"
 #include "pg/cpu.h"
 #include "pg/dlog.h"
 #include "pg/fdt_handler.h"
@@ -95,7 +96,7 @@ void cpu_entry(struct cpu *c);
  * page table returned is used to set up the MMU and caches for all subsequent
  * code.
  */
-void one_time_init_mm(void)
+COLD_TEXT void one_time_init_mm(void)
 {
 	/* Make sure the console is initialised before calling dlog. */
 	plat_console_init();
@@ -113,7 +114,7 @@ void one_time_init_mm(void)
 /**
  * Performs one-time initialisation of the hypervisor.
  */
-void one_time_init(void)
+COLD_TEXT void one_time_init(void)
 {
 	struct string manifest_fname = STRING_INIT("manifest.dtb");
 	struct memiter manifest_it;
@@ -35,6 +35,7 @@
 #include "pg/arch/tee/mediator.h"
 #include "pg/arch/emulator.h"
 #include "pg/arch/virt_devs.h"
+#include "pg/arch/virtioac.h"
 
 #include "pg/manifest.h"
 #include "pg/plat/console.h"
@@ -45,6 +46,7 @@
 #include "pg/api.h"
 #include "pg/boot_params.h"
 #include "pg/check.h"
+#include "pg/code_layout.h"
 #include "pg/dlog.h"
 #include "pg/layout.h"
 #include "pg/memiter.h"
@@ -536,8 +538,12 @@ load_common(struct mm_stage1_locked stage1_locked,
     uint64_t                    vm_int = 0;  /* VM physical interrupts        */
     bool                        ans;         /* answer                        */
 
-    vm_locked.vm->smc_whitelist = manifest_vm->smc_whitelist;
-    vm_locked.vm->uuid          = manifest_vm->uuid;
+    vm_locked.vm->smc_whitelist   = manifest_vm->smc_whitelist;
+    vm_locked.vm->uuid            = manifest_vm->uuid;
+    vm_locked.vm->wfi_idle        = manifest_vm->wfi_idle;
+    vm_locked.vm->halt_poll       = manifest_vm->halt_poll;
+    vm_locked.vm->wfx_passthrough = manifest_vm->wfx_passthrough;
+    vm_locked.vm->vgic_lr         = manifest_vm->vgic_lr;
 
     /* handle interrupt allocations for each device */
     for (size_t i = 0; i < manifest_vm->dev_region_count; i++) {
@@ -868,6 +874,13 @@ ramdisk_load_done:
                  vgic_end, MM_MODE_D, ppool, NULL);
     init_vgic(manifest_vm->vm);
 
+    ans = register_vgic_mmio(manifest_vm->vm, manifest_vm->mem_layout.gic);
+    GOTO(!ans, out, "VM: %#x, unable to register vGIC MMIO regions\n", vm->id);
+
+    /* reads of (most of) the vGIC model need not trap */
+    ans = map_vgic_model(manifest_vm->vm, manifest_vm->mem_layout.gic, ppool);
+    GOTO(!ans, out, "VM: %#x, unable to map vGIC model readable\n", vm->id);
+
     dlog_debug("VM: %#x, vGIC mapped to VM's IPA space\n", vm->id);
 
 gic_load_done:
@@ -910,6 +923,13 @@ gic_load_done:
     ans = init_virt_devs();
     GOTO(ans, out, "VS: %#x, unable to initialize virtual devices\n", vm->id);
 
+    /* route traps on emulated MMIO regions to their emulators */
+    ans = register_virt_devs(&vm->mmio);
+    GOTO(ans, out, "VM: %#x, unable to register virtual devices\n", vm->id);
+
+    ans = virtioac_register(&vm->mmio);
+    GOTO(!ans, out, "VM: %#x, unable to register VirtIO window\n", vm->id);
+
     dlog_debug("VM: %#x, loaded with %u vCPUs, entry at PA=%#x IPA=%#x.\n",
                vm->id, vm->vcpu_count, pa_addr(kernel_start),
                manifest_vm->boot_address);
@@ -944,7 +964,7 @@ out:
  *
  *  @return : true if everything went well; false otherwise
  */
-bool
+COLD_TEXT bool
 load_vms(struct mm_stage1_locked   stage1_locked,
          struct manifest           *manifest,
          const struct memiter      *cpio,
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#include "pg/lock_stats.h"
+
+#if LOCK_STATS
+
+#include <stdatomic.h>
+
+#include "pg/dlog.h"
+
+/**
+ * Accumulated statistics of one (site, caller) pair. Entries are claimed
+ * lock-free by the first CPU that publishes its key; counters are updated with
+ * relaxed atomics since they are only ever read for reporting.
+ */
+struct lock_stats_entry {
+	_Atomic(const struct lock_stats_site *) site;
+	_Atomic uintptr_t caller;
+	_Atomic uint64_t acquisitions;
+	_Atomic uint64_t contended;
+	_Atomic uint64_t spins;
+	_Atomic uint64_t wait_ticks;
+	_Atomic uint64_t hold_ticks;
+	_Atomic uint64_t hold_max;
+};
+
+static struct lock_stats_entry entries[LOCK_STATS_MAX_ENTRIES];
+
+/* placeholder key of an entry that is being claimed */
+static const struct lock_stats_site claiming;
+
+/* acquisitions that could not be attributed because the table was full */
+static _Atomic uint64_t dropped;
+
+/* lock_stats_lookup - Finds (or claims) the entry of a (site, caller) pair
+ *  @site   : lock statement
+ *  @caller : return address of the function containing the lock statement
+ *
+ *  @return : ptr to entry or NULL if the table is full
+ */
+static struct lock_stats_entry *
+lock_stats_lookup(const struct lock_stats_site *site, uintptr_t caller)
+{
+    const struct lock_stats_site *expected;  /* CAS comparand            */
+    struct lock_stats_entry      *entry;     /* current probe            */
+    size_t                       idx;        /* open addressing index    */
+
+    idx = (((uintptr_t) site >> 3) ^ (caller >> 2)) % LOCK_STATS_MAX_ENTRIES;
+
+    for (size_t i = 0; i < LOCK_STATS_MAX_ENTRIES; ++i) {
+        entry = &entries[(idx + i) % LOCK_STATS_MAX_ENTRIES];
+
+        /* claim empty slot; the key is published only after the caller *
+         * has been written so that lookups never match a partial key   */
+        expected = atomic_load_explicit(&entry->site, memory_order_acquire);
+        if (expected == NULL
+        &&  atomic_compare_exchange_strong_explicit(&entry->site, &expected,
+                &claiming, memory_order_acquire, memory_order_acquire)) {
+            atomic_store_explicit(&entry->caller, caller,
+                                  memory_order_relaxed);
+            atomic_store_explicit(&entry->site, site, memory_order_release);
+            return entry;
+        }
+
+        /* slot is being claimed concurrently; it may be for the same key */
+        while (expected == &claiming)
+            expected = atomic_load_explicit(&entry->site,
+                                            memory_order_acquire);
+
+        if (expected == site
+        &&  atomic_load_explicit(&entry->caller, memory_order_relaxed)
+            == caller)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/* lock_stats_acquired - Accounts for a successful lock acquisition
+ *  @site       : lock statement
+ *  @caller     : return address of the function containing the statement
+ *  @spins      : number of times the CPU waited for the lock to be released
+ *  @wait_ticks : counter ticks elapsed until the lock was taken
+ *
+ *  @return : entry that the hold time must be accounted to; may be NULL
+ */
+struct lock_stats_entry *
+lock_stats_acquired(const struct lock_stats_site *site,
+                    uintptr_t                    caller,
+                    uint64_t                     spins,
+                    uint64_t                     wait_ticks)
+{
+    struct lock_stats_entry *entry;  /* (site, caller) accumulator */
+
+    entry = lock_stats_lookup(site, caller);
+    if (!entry) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    atomic_fetch_add_explicit(&entry->acquisitions, 1, memory_order_relaxed);
+    if (spins) {
+        atomic_fetch_add_explicit(&entry->contended, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&entry->spins, spins, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&entry->wait_ticks, wait_ticks,
+                              memory_order_relaxed);
+
+    return entry;
+}
+
+/* lock_stats_released - Accounts for the time a lock has been held
+ *  @entry      : value returned by lock_stats_acquired() (NULL is ignored)
+ *  @hold_ticks : counter ticks elapsed between acquisition and release
+ */
+void
+lock_stats_released(struct lock_stats_entry *entry, uint64_t hold_ticks)
+{
+    uint64_t max;  /* currently recorded maximum hold time */
+
+    if (!entry)
+        return;
+
+    atomic_fetch_add_explicit(&entry->hold_ticks, hold_ticks,
+                              memory_order_relaxed);
+
+    max = atomic_load_explicit(&entry->hold_max, memory_order_relaxed);
+    while (hold_ticks > max
+    &&     !atomic_compare_exchange_weak_explicit(&entry->hold_max, &max,
+                hold_ticks, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/* lock_stats_dump - Prints the most contended lock sites
+ *  @top_n : number of entries to print (0 selects the default)
+ *
+ * Entries are ranked by the total time spent waiting for the lock. Caller
+ * addresses can be resolved against the hypervisor ELF with addr2line.
+ */
+void
+lock_stats_dump(uint32_t top_n)
+{
+    struct lock_stats_entry       *top[LOCK_STATS_MAX_ENTRIES];
+    const struct lock_stats_site  *site;   /* key of current entry    */
+    struct lock_stats_entry       *entry;  /* current entry           */
+    uint64_t                      wait;    /* ranking key             */
+    size_t                        count;   /* number of ranked items  */
+    size_t                        j;       /* insertion position      */
+
+    if (!top_n || top_n > LOCK_STATS_MAX_ENTRIES)
+        top_n = LOCK_STATS_DEFAULT_TOP_N;
+
+    /* insertion sort on wait time, keeping only the top N */
+    count = 0;
+    for (size_t i = 0; i < LOCK_STATS_MAX_ENTRIES; ++i) {
+        entry = &entries[i];
+        site  = atomic_load_explicit(&entry->site, memory_order_acquire);
+        if (!site || site == &claiming)
+            continue;
+
+        wait = atomic_load_explicit(&entry->wait_ticks, memory_order_relaxed);
+        for (j = count; j > 0; --j) {
+            if (atomic_load_explicit(&top[j - 1]->wait_ticks,
+                                     memory_order_relaxed) >= wait)
+                break;
+            if (j < top_n)
+                top[j] = top[j - 1];
+        }
+
+        if (j < top_n) {
+            top[j] = entry;
+            if (count < top_n)
+                count++;
+        }
+    }
+
+    dlog("lock stats: top %u sites by wait time (ticks), "
+         "%u unattributed acquisitions\n", count,
+         atomic_load_explicit(&dropped, memory_order_relaxed));
+
+    for (size_t i = 0; i < count; ++i) {
+        entry = top[i];
+        site  = atomic_load_explicit(&entry->site, memory_order_relaxed);
+
+        dlog("  %s (%s:%u) caller %#x\n"
+             "    acq %u contended %u spins %u wait %u hold %u max %u\n",
+             site->name, site->file, site->line,
+             atomic_load_explicit(&entry->caller, memory_order_relaxed),
+             atomic_load_explicit(&entry->acquisitions, memory_order_relaxed),
+             atomic_load_explicit(&entry->contended, memory_order_relaxed),
+             atomic_load_explicit(&entry->spins, memory_order_relaxed),
+             atomic_load_explicit(&entry->wait_ticks, memory_order_relaxed),
+             atomic_load_explicit(&entry->hold_ticks, memory_order_relaxed),
+             atomic_load_explicit(&entry->hold_max, memory_order_relaxed));
+    }
+}
+
+#endif /* LOCK_STATS */
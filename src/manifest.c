@@ -459,6 +459,32 @@ parse_vm(struct fdt_node    *node,
         "unable to access \"requires_identity_mapping\" property (%s)\n",
         manifest_strerror(ans));
 
+    ans = read_bool(vm_id, node, "wfi_idle_in_hypervisor", &vm->wfi_idle);
+    RET(ans != MANIFEST_SUCCESS, ans,
+        "unable to access \"wfi_idle_in_hypervisor\" property (%s)\n",
+        manifest_strerror(ans));
+
+    ans = read_bool(vm_id, node, "wfi_halt_poll", &vm->halt_poll);
+    RET(ans != MANIFEST_SUCCESS, ans,
+        "unable to access \"wfi_halt_poll\" property (%s)\n",
+        manifest_strerror(ans));
+
+    ans = read_bool(vm_id, node, "wfx_passthrough", &vm->wfx_passthrough);
+    RET(ans != MANIFEST_SUCCESS, ans,
+        "unable to access \"wfx_passthrough\" property (%s)\n",
+        manifest_strerror(ans));
+
+    ans = read_bool(vm_id, node, "vgic_list_registers", &vm->vgic_lr);
+    RET(ans != MANIFEST_SUCCESS, ans,
+        "unable to access \"vgic_list_registers\" property (%s)\n",
+        manifest_strerror(ans));
+
+    /* idling or polling in the hypervisor requires WFI to be trapped */
+    RET((vm->wfi_idle || vm->halt_poll) && vm->wfx_passthrough,
+        MANIFEST_ERROR_WFX_POLICY_CONFLICT,
+        "\"wfx_passthrough\" excludes \"wfi_idle_in_hypervisor\" and "
+        "\"wfi_halt_poll\"\n");
+
     /* create copy of node as we need the parent of mem_node *
      * again for device regions                              */
     struct fdt_node mem_node = { node->fdt, node->offset };
@@ -560,6 +586,8 @@ manifest_strerror(enum manifest_return_code ret_code)
             return "RX and TX buffers should be of same size";
         case MANIFEST_ERROR_MALFORMED_UUID:
             return "Malformed UUID";
+        case MANIFEST_ERROR_WFX_POLICY_CONFLICT:
+            return "Conflicting WFI/WFE trapping options";
         default:
             panic("Unexpected manifest return code.");
             return NULL;
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "pg/manifest.h"
+#include "pg/memiter.h"
+}
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+using ::testing::Eq;
+
+using struct_manifest = struct manifest;
+
+constexpr uint32_t FDT_MAGIC = 0xd00dfeed;
+constexpr uint32_t FDT_BEGIN_NODE = 0x1;
+constexpr uint32_t FDT_END_NODE = 0x2;
+constexpr uint32_t FDT_PROP = 0x3;
+constexpr uint32_t FDT_END = 0x9;
+
+/**
+ * Assembles a flattened device tree blob in memory so that manifests can be
+ * written inline in the tests rather than as pre-compiled hex dumps.
+ */
+class FdtBuilder
+{
+       public:
+	FdtBuilder &StartNode(const std::string &name)
+	{
+		AppendU32(structs_, FDT_BEGIN_NODE);
+		AppendString(structs_, name);
+		return *this;
+	}
+
+	FdtBuilder &EndNode()
+	{
+		AppendU32(structs_, FDT_END_NODE);
+		return *this;
+	}
+
+	FdtBuilder &Property(const std::string &name,
+			     const std::vector<uint8_t> &value)
+	{
+		AppendU32(structs_, FDT_PROP);
+		AppendU32(structs_, value.size());
+		AppendU32(structs_, strings_.size());
+		strings_.insert(strings_.end(), name.begin(), name.end());
+		strings_.push_back('\0');
+		structs_.insert(structs_.end(), value.begin(), value.end());
+		Align(structs_);
+		return *this;
+	}
+
+	FdtBuilder &BooleanProperty(const std::string &name)
+	{
+		return Property(name, {});
+	}
+
+	FdtBuilder &StringProperty(const std::string &name,
+				   const std::string &value)
+	{
+		std::vector<uint8_t> v(value.begin(), value.end());
+
+		v.push_back('\0');
+		return Property(name, v);
+	}
+
+	FdtBuilder &Uint32Property(const std::string &name, uint32_t value)
+	{
+		std::vector<uint8_t> v;
+
+		AppendU32(v, value);
+		return Property(name, v);
+	}
+
+	FdtBuilder &Uint64Property(const std::string &name, uint64_t value)
+	{
+		std::vector<uint8_t> v;
+
+		AppendU32(v, value >> 32);
+		AppendU32(v, value);
+		return Property(name, v);
+	}
+
+	std::vector<uint8_t> Build()
+	{
+		constexpr uint32_t header_size = 40;
+		constexpr uint32_t rsvmap_size = 16;
+		std::vector<uint8_t> blob;
+		std::vector<uint8_t> structs = structs_;
+
+		AppendU32(structs, FDT_END);
+
+		AppendU32(blob, FDT_MAGIC);
+		AppendU32(blob, header_size + rsvmap_size + structs.size() +
+					strings_.size());
+		AppendU32(blob, header_size + rsvmap_size);
+		AppendU32(blob, header_size + rsvmap_size + structs.size());
+		AppendU32(blob, header_size);
+		AppendU32(blob, 17);
+		AppendU32(blob, 16);
+		AppendU32(blob, 0);
+		AppendU32(blob, strings_.size());
+		AppendU32(blob, structs.size());
+
+		blob.resize(blob.size() + rsvmap_size, 0);
+		blob.insert(blob.end(), structs.begin(), structs.end());
+		blob.insert(blob.end(), strings_.begin(), strings_.end());
+		return blob;
+	}
+
+       private:
+	static void AppendU32(std::vector<uint8_t> &v, uint32_t value)
+	{
+		v.push_back(value >> 24);
+		v.push_back(value >> 16);
+		v.push_back(value >> 8);
+		v.push_back(value);
+	}
+
+	static void AppendString(std::vector<uint8_t> &v, const std::string &s)
+	{
+		v.insert(v.end(), s.begin(), s.end());
+		v.push_back('\0');
+		Align(v);
+	}
+
+	static void Align(std::vector<uint8_t> &v)
+	{
+		v.resize((v.size() + 3) & ~size_t{3}, 0);
+	}
+
+	std::vector<uint8_t> structs_;
+	std::vector<uint8_t> strings_;
+};
+
+class manifest : public ::testing::Test
+{
+       protected:
+	void SetUp() override
+	{
+		m = std::make_unique<struct_manifest>();
+	}
+
+	/**
+	 * Parses a manifest with a single primary VM that has the given
+	 * boolean properties set.
+	 */
+	enum manifest_return_code ParseVm(
+		const std::vector<std::string> &flags)
+	{
+		FdtBuilder builder;
+		struct_manifest *m_ptr = m.get();
+		struct memiter it;
+
+		builder.StartNode("")
+			.StartNode("hypervisor")
+			.StringProperty("compatible", "peregrine,peregrine")
+			.StartNode("vm1")
+			.StringProperty("debug_name", "primary")
+			.BooleanProperty("is_primary")
+			.Uint32Property("vcpu_count", 1)
+			.Uint32Property("cpus", 0);
+#if MEASURED_BOOT
+		builder.Uint32Property("hash_algo_id", 0)
+			.Uint32Property("hash_size", 0);
+#endif
+		for (const std::string &flag : flags) {
+			builder.BooleanProperty(flag);
+		}
+		builder.StartNode("ipa-memory-layout")
+			.Uint64Property("kernel", 0x80000000)
+			.EndNode()
+			.EndNode()
+			.EndNode()
+			.EndNode();
+
+		dtb = builder.Build();
+		memiter_init(&it, dtb.data(), dtb.size());
+		return manifest_init(nullptr, &m_ptr, &it);
+	}
+
+	std::unique_ptr<struct_manifest> m;
+
+       private:
+	/* Properties of the parsed manifest point into the blob. */
+	std::vector<uint8_t> dtb;
+};
+
+/**
+ * A VM idles in its vCPUs' WFIs only if the manifest asks for it.
+ */
+TEST_F(manifest, wfi_idle_in_hypervisor)
+{
+	ASSERT_THAT(ParseVm({}), Eq(MANIFEST_SUCCESS));
+	ASSERT_THAT(m->vm_count, Eq(1));
+	EXPECT_FALSE(m->vm[0].wfi_idle);
+
+	ASSERT_THAT(ParseVm({"wfi_idle_in_hypervisor"}), Eq(MANIFEST_SUCCESS));
+	EXPECT_TRUE(m->vm[0].wfi_idle);
+}
+
+/**
+ * WFI/WFE pass-through is opt-in and parsed from the manifest.
+ */
+TEST_F(manifest, wfx_passthrough)
+{
+	ASSERT_THAT(ParseVm({}), Eq(MANIFEST_SUCCESS));
+	EXPECT_FALSE(m->vm[0].wfx_passthrough);
+
+	ASSERT_THAT(ParseVm({"wfx_passthrough"}), Eq(MANIFEST_SUCCESS));
+	EXPECT_TRUE(m->vm[0].wfx_passthrough);
+	EXPECT_FALSE(m->vm[0].wfi_idle);
+}
+
+/**
+ * Idling in the hypervisor needs WFI to trap, which pass-through rules out.
+ */
+TEST_F(manifest, wfx_policy_conflict)
+{
+	EXPECT_THAT(ParseVm({"wfi_idle_in_hypervisor", "wfx_passthrough"}),
+		    Eq(MANIFEST_ERROR_WFX_POLICY_CONFLICT));
+	EXPECT_THAT(ParseVm({"wfi_halt_poll", "wfx_passthrough"}),
+		    Eq(MANIFEST_ERROR_WFX_POLICY_CONFLICT));
+}
+
+/**
+ * Halt polling is enabled per VM and can be combined with idling in the
+ * hypervisor.
+ */
+TEST_F(manifest, wfi_halt_poll)
+{
+	ASSERT_THAT(ParseVm({}), Eq(MANIFEST_SUCCESS));
+	EXPECT_FALSE(m->vm[0].halt_poll);
+
+	ASSERT_THAT(ParseVm({"wfi_halt_poll"}), Eq(MANIFEST_SUCCESS));
+	EXPECT_TRUE(m->vm[0].halt_poll);
+
+	ASSERT_THAT(ParseVm({"wfi_halt_poll", "wfi_idle_in_hypervisor"}),
+		    Eq(MANIFEST_SUCCESS));
+	EXPECT_TRUE(m->vm[0].halt_poll);
+	EXPECT_TRUE(m->vm[0].wfi_idle);
+}
+
+} /* namespace */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "pg/mmio.h"
+
+#include "pg/code_layout.h"
+#include "pg/dlog.h"
+#include "pg/error.h"
+
+/* mmio_lower_bound - Finds the first region that ends above an address
+ *  @table : table to search
+ *  @ipa   : address in question
+ *
+ *  @return : index of the first region with end > ipa; table->count if none
+ */
+static HOT_TEXT size_t
+mmio_lower_bound(const struct mmio_table *table, uintpaddr_t ipa)
+{
+    size_t lo = 0;              /* first candidate           */
+    size_t hi = table->count;   /* one past last candidate   */
+    size_t mid;                 /* current probe             */
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (table->regions[mid].end <= ipa)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* mmio_region_add - Registers an emulated MMIO region
+ *  @table  : table of the VM
+ *  @begin  : first IPA of the region
+ *  @end    : first IPA after the region
+ *  @access : emulator in charge of the region
+ *  @ctx    : emulator-specific context
+ *
+ *  @return : true if everything went well; false otherwise
+ *
+ * Only to be used while the VM is being loaded; regions must not overlap.
+ */
+bool
+mmio_region_add(struct mmio_table *table,
+                uintpaddr_t       begin,
+                uintpaddr_t       end,
+                mmio_access_t     access,
+                void              *ctx)
+{
+    size_t pos;     /* insertion position */
+
+    RET(begin >= end || !access, false,
+        "Invalid MMIO region [%#x - %#x)\n", begin, end);
+    RET(table->count >= MMIO_REGIONS_MAX, false, "Too many MMIO regions\n");
+
+    /* the region at pos is the only one that may overlap from above */
+    pos = mmio_lower_bound(table, begin);
+    RET(pos < table->count && table->regions[pos].begin < end, false,
+        "MMIO region [%#x - %#x) overlaps [%#x - %#x)\n", begin, end,
+        table->regions[pos].begin, table->regions[pos].end);
+
+    for (size_t i = table->count; i > pos; i--)
+        table->regions[i] = table->regions[i - 1];
+
+    table->regions[pos] = (struct mmio_region) {
+        .begin  = begin,
+        .end    = end,
+        .access = access,
+        .ctx    = ctx,
+    };
+    table->count++;
+
+    return true;
+}
+
+/* mmio_region_find - Looks up the emulated MMIO region of an IPA
+ *  @table : table of the VM
+ *  @ipa   : faulting IPA
+ *
+ *  @return : ptr to region or NULL if the IPA is not emulated
+ */
+HOT_TEXT const struct mmio_region *
+mmio_region_find(const struct mmio_table *table, uintpaddr_t ipa)
+{
+    size_t pos;     /* candidate region */
+
+    pos = mmio_lower_bound(table, ipa);
+    if (pos < table->count && table->regions[pos].begin <= ipa)
+        return &table->regions[pos];
+
+    return NULL;
+}
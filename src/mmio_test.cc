@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "pg/mmio.h"
+}
+
+namespace
+{
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+bool access_stub(uintreg_t, uintreg_t, uint8_t, struct vcpu *,
+		 struct vcpu_fault_info *, const struct mmio_region *)
+{
+	return true;
+}
+
+/**
+ * Regions added in any order are kept sorted and can be found by any address
+ * they contain, but not by the addresses between them.
+ */
+TEST(mmio, find_after_unordered_add)
+{
+	struct mmio_table table = {};
+	int ctx[3];
+
+	EXPECT_TRUE(mmio_region_add(&table, 0x3000, 0x4000, access_stub,
+				    &ctx[1]));
+	EXPECT_TRUE(mmio_region_add(&table, 0x8000, 0x8100, access_stub,
+				    &ctx[2]));
+	EXPECT_TRUE(mmio_region_add(&table, 0x1000, 0x2000, access_stub,
+				    &ctx[0]));
+	ASSERT_EQ(table.count, 3U);
+
+	for (size_t i = 1; i < table.count; i++) {
+		EXPECT_LE(table.regions[i - 1].end, table.regions[i].begin);
+	}
+
+	EXPECT_THAT(mmio_region_find(&table, 0x0fff), IsNull());
+	ASSERT_THAT(mmio_region_find(&table, 0x1000), NotNull());
+	EXPECT_EQ(mmio_region_find(&table, 0x1000)->ctx, &ctx[0]);
+	EXPECT_EQ(mmio_region_find(&table, 0x1fff)->ctx, &ctx[0]);
+	EXPECT_THAT(mmio_region_find(&table, 0x2000), IsNull());
+	EXPECT_EQ(mmio_region_find(&table, 0x3800)->ctx, &ctx[1]);
+	EXPECT_EQ(mmio_region_find(&table, 0x80ff)->ctx, &ctx[2]);
+	EXPECT_THAT(mmio_region_find(&table, 0x8100), IsNull());
+}
+
+/**
+ * Overlapping, empty and excess regions are rejected and leave the table
+ * unchanged.
+ */
+TEST(mmio, reject_invalid)
+{
+	struct mmio_table table = {};
+
+	EXPECT_TRUE(mmio_region_add(&table, 0x2000, 0x3000, access_stub, NULL));
+	EXPECT_FALSE(mmio_region_add(&table, 0x2fff, 0x4000, access_stub, NULL));
+	EXPECT_FALSE(mmio_region_add(&table, 0x1000, 0x2001, access_stub, NULL));
+	EXPECT_FALSE(mmio_region_add(&table, 0x1000, 0x4000, access_stub, NULL));
+	EXPECT_FALSE(mmio_region_add(&table, 0x5000, 0x5000, access_stub, NULL));
+	EXPECT_FALSE(mmio_region_add(&table, 0x5000, 0x6000, NULL, NULL));
+	EXPECT_EQ(table.count, 1U);
+
+	/* Adjacent regions are fine. */
+	EXPECT_TRUE(mmio_region_add(&table, 0x1000, 0x2000, access_stub, NULL));
+	EXPECT_TRUE(mmio_region_add(&table, 0x3000, 0x4000, access_stub, NULL));
+
+	while (table.count < MMIO_REGIONS_MAX) {
+		uintpaddr_t begin = 0x10000 + table.count * 0x1000;
+
+		ASSERT_TRUE(mmio_region_add(&table, begin, begin + 0x1000,
+					    access_stub, NULL));
+	}
+	EXPECT_FALSE(mmio_region_add(&table, 0x100000, 0x101000, access_stub,
+				     NULL));
+}
+} /* namespace */
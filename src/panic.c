@@ -11,6 +11,7 @@
 #include <stdarg.h>
 
 #include "pg/abort.h"
+#include "pg/code_layout.h"
 #include "pg/dlog.h"
 
 /**
@@ -18,7 +19,7 @@
  *
  * TODO: Determine if we want to omit strings on non-debug builds.
  */
-noreturn void panic(const char *fmt, ...)
+COLD_TEXT noreturn void panic(const char *fmt, ...)
 {
 	va_list args;
 
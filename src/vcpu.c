@@ -33,9 +33,13 @@
 
 #include "pg/check.h"
 #include "pg/dlog.h"
+#include "pg/static_assert.h"
 #include "pg/std.h"
 #include "pg/vm.h"
 
+static_assert(offsetof(struct vcpu, regs) <= VCPU_REGS_OFFSET_MAX,
+	      "vCPU register save area out of reach of exceptions.S");
+
 /**
  * Locks the given vCPU and updates `locked` to hold the newly locked vCPU.
  */
@@ -84,6 +88,11 @@ bool vcpu_init(struct vcpu *vcpu, struct vm *vm)
 	vcpu->vm = vm;
 	vcpu->state = VCPU_STATE_OFF;
 
+	/* All interrupts start out at the highest priority. */
+	for (uint32_t i = 0; i < INTERRUPT_REGISTER_COUNT; ++i) {
+		vcpu->interrupts.priority_level[0][i] = UINT32_MAX;
+	}
+
 	return true;
 }
 
@@ -95,6 +104,7 @@ void vcpu_on(struct vcpu_locked vcpu, ipaddr_t entry, uintreg_t arg)
 {
 	arch_regs_set_pc_arg(&vcpu.vcpu->regs, entry, arg);
 	vcpu.vcpu->state = VCPU_STATE_READY;
+	vm_set_vcpu_online(vcpu.vcpu->vm, vcpu_index(vcpu.vcpu), true);
 }
 
 uint16_t vcpu_index(const struct vcpu *vcpu)
@@ -206,6 +216,30 @@ bool vcpu_handle_page_fault(const struct vcpu *current,
 	return resume;
 }
 
+/**
+ * Sets the priority of a virtual interrupt, of which only the upper
+ * INTERRUPT_PRIORITY_BITS are kept. Lower values are higher priorities, as on
+ * the GIC. The caller must hold the vCPU lock.
+ */
+void vcpu_interrupt_priority_set(struct vcpu_locked vcpu_locked,
+				 uint32_t intid, uint8_t priority)
+{
+	struct interrupts *irqs = &vcpu_locked.vcpu->interrupts;
+	uint32_t index = intid / INTERRUPT_REGISTER_BITS;
+	uint32_t mask = 1U << (intid % INTERRUPT_REGISTER_BITS);
+	uint8_t level = priority >> (8 - INTERRUPT_PRIORITY_BITS);
+
+	CHECK(intid < PG_NUM_INTIDS);
+
+	/* Leave the old level, updating its summary bit. */
+	irqs->priority_level[irqs->interrupt_priority[intid]][index] &= ~mask;
+	vcpu_interrupt_summary_update(vcpu_locked, intid);
+
+	irqs->interrupt_priority[intid] = level;
+	irqs->priority_level[level][index] |= mask;
+	vcpu_interrupt_summary_update(vcpu_locked, intid);
+}
+
 void vcpu_reset(struct vcpu *vcpu)
 {
 	arch_cpu_init(vcpu->cpu, vcpu->vm->secondary_ep);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "pg/api.h"
+#include "pg/vm.h"
+}
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace
+{
+using struct_vm = struct vm;
+
+class vcpu_interrupts : public ::testing::Test
+{
+       protected:
+	void SetUp() override
+	{
+		test_vm = std::make_unique<struct_vm>();
+		vcpu = &test_vm->vcpus[0];
+		test_vm->id = PG_PRIMARY_VM_ID + 1;
+		test_vm->vcpu_count = 1;
+		ASSERT_TRUE(vcpu_init(vcpu, test_vm.get()));
+	}
+
+	void inject(uint32_t intid)
+	{
+		struct vcpu_locked vcpu_locked = vcpu_lock(vcpu);
+
+		EXPECT_EQ(api_interrupt_inject_locked(vcpu_locked, intid, vcpu,
+						      NULL),
+			  0);
+		vcpu_unlock(&vcpu_locked);
+	}
+
+	std::unique_ptr<struct_vm> test_vm;
+	struct vcpu *vcpu;
+};
+
+/**
+ * Interrupts of equal priority are returned in order of their IDs, across the
+ * words of the bitfields.
+ */
+TEST_F(vcpu_interrupts, get_lowest_id_first)
+{
+	for (uint32_t intid : {40U, 3U, 33U, 7U}) {
+		EXPECT_EQ(api_interrupt_enable(intid, true, INTERRUPT_TYPE_IRQ,
+					       vcpu),
+			  0);
+		inject(intid);
+	}
+
+	EXPECT_EQ(api_interrupt_get(vcpu), 3U);
+	EXPECT_EQ(api_interrupt_get(vcpu), 7U);
+	EXPECT_EQ(api_interrupt_get(vcpu), 33U);
+	EXPECT_EQ(api_interrupt_get(vcpu), 40U);
+	EXPECT_EQ(api_interrupt_get(vcpu), PG_INVALID_INTID);
+	EXPECT_EQ(vcpu_interrupt_irq_count_read(vcpu), 0U);
+}
+
+/**
+ * Higher priorities (lower values) are returned first, only enabled interrupts
+ * are returned, and reprioritising a pending interrupt takes effect at once.
+ */
+TEST_F(vcpu_interrupts, get_highest_priority_first)
+{
+	EXPECT_EQ(api_interrupt_set_priority(PG_NUM_INTIDS, 0, vcpu), -1);
+
+	EXPECT_EQ(api_interrupt_set_priority(2, 0xa0, vcpu), 0);
+	EXPECT_EQ(api_interrupt_set_priority(45, 0x20, vcpu), 0);
+	EXPECT_EQ(api_interrupt_set_priority(9, 0x80, vcpu), 0);
+	EXPECT_EQ(api_interrupt_set_priority(60, 0x80, vcpu), 0);
+
+	for (uint32_t intid : {2U, 9U, 45U, 60U}) {
+		EXPECT_EQ(api_interrupt_enable(intid, true, INTERRUPT_TYPE_IRQ,
+					       vcpu),
+			  0);
+		inject(intid);
+	}
+	EXPECT_EQ(api_interrupt_enable(45, false, INTERRUPT_TYPE_IRQ, vcpu),
+		  0);
+	EXPECT_EQ(api_interrupt_set_priority(2, 0x10, vcpu), 0);
+	EXPECT_EQ(vcpu_interrupt_irq_count_read(vcpu), 3U);
+
+	EXPECT_EQ(api_interrupt_get(vcpu), 2U);
+	EXPECT_EQ(api_interrupt_get(vcpu), 9U);
+
+	/* Re-enabling a pending interrupt makes it visible again. */
+	EXPECT_EQ(api_interrupt_enable(45, true, INTERRUPT_TYPE_IRQ, vcpu),
+		  0);
+	EXPECT_EQ(api_interrupt_get(vcpu), 45U);
+	EXPECT_EQ(api_interrupt_get(vcpu), 60U);
+	EXPECT_EQ(api_interrupt_get(vcpu), PG_INVALID_INTID);
+	EXPECT_EQ(vcpu->interrupts.pending_summary, 0U);
+}
+
+/**
+ * The lock-free reader on the return-to-guest path never observes the count
+ * of an interrupt injected from another CPU without also observing its
+ * pending bit.
+ */
+TEST_F(vcpu_interrupts, count_read_implies_pending)
+{
+	constexpr uint32_t intid = 5;
+	constexpr uint32_t rounds = 10000;
+	std::atomic<uint32_t> consumed{0};
+
+	EXPECT_EQ(api_interrupt_enable(intid, true, INTERRUPT_TYPE_IRQ, vcpu),
+		  0);
+
+	std::thread injector([&] {
+		for (uint32_t i = 0; i < rounds; ++i) {
+			while (consumed.load(std::memory_order_relaxed) != i) {
+			}
+			inject(intid);
+		}
+	});
+
+	for (uint32_t i = 0; i < rounds; ++i) {
+		while (vcpu_interrupt_irq_count_read(vcpu) == 0) {
+		}
+		EXPECT_TRUE(atomic_load_explicit(
+				    &vcpu->interrupts.interrupt_pending[0],
+				    memory_order_relaxed) &
+			    (1U << intid));
+		EXPECT_EQ(api_interrupt_get(vcpu), intid);
+		consumed.store(i + 1, std::memory_order_relaxed);
+	}
+
+	injector.join();
+}
+} /* namespace */
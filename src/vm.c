@@ -34,6 +34,7 @@
 #include "pg/cpu.h"
 #include "pg/layout.h"
 #include "pg/plat/iommu.h"
+#include "pg/static_assert.h"
 #include "pg/std.h"
 #include "pg/dlog.h"
 #include "pg/pma.h"
@@ -41,6 +42,8 @@
 
 #include "vmapi/pg/call.h"
 
+static_assert(MAX_CPUS <= 64, "vcpus_online bitmap too small for MAX_CPUS");
+
 static struct vm vms[MAX_VMS];
 static uint16_t  vm_count;
 static struct vm *first_boot_vm;
@@ -75,6 +78,7 @@ struct vm *vm_init(uint16_t id,
     list_init(&vm->mailbox.waiter_list);
     list_init(&vm->mailbox.ready_list);
     sl_init(&vm->lock);
+    seq_init(&vm->placement);
 
     vm->id = id;
     vm->vcpu_count = vcpu_count;
@@ -100,15 +104,22 @@ struct vm *vm_init(uint16_t id,
     /* assign physical CPUs to VM                           *
      * NOTE: vCPU - pCPU mapping should be provided by user *
      *       vCPU scheduling on pCPUs not yet supported     */
+    seq_write_lock(&vm->placement);
     for (size_t i = 0; i < vcpu_count; i++) {
         cpu = cpu_find(vm_cpus[i]);
-        RET(!cpu, NULL, "Unable to find CPU %#x\n", vm_cpus[i]);
+        if (!cpu) {
+            seq_write_unlock(&vm->placement);
+            RET(true, NULL, "Unable to find CPU %#x\n", vm_cpus[i]);
+        }
 
         vm->cpus[i] = cpu->id;
         cpu->is_assigned = true;
+        cpu->vm = vm;
+        cpu->vcpu_index = i;
         dlog_debug("Assigned CPU %#x to VM %u (%u / %u)\n",
                    vm->cpus[i], vm->id, i + 1, vcpu_count);
     }
+    seq_write_unlock(&vm->placement);
 
     /* WARNING: At this point, the vCPUs are initialized and the "cpus" *
      *          component of the VM structure contains the assigned     *
@@ -200,30 +211,131 @@ struct vm *vm_find_index(uint16_t index)
 	return &vms[index];
 }
 
+/* vm_placement_get - Takes a consistent snapshot of the vCPU placement
+ *  @vm   : VM in question
+ *  @cpus : [out] physical CPU assigned to each vCPU (may be NULL)
+ *
+ *  @return : bitmap of vCPUs that are currently powered on
+ *
+ * Does not take the VM lock, so it may be used on trap handling paths that
+ * run concurrently on several physical CPUs of the same VM.
+ */
+uint64_t
+vm_placement_get(struct vm *vm, cpu_id_t cpus[MAX_CPUS])
+{
+    uint64_t online;    /* bitmap of powered on vCPUs */
+    uint32_t seq;       /* placement sequence number  */
+
+    do {
+        seq    = seq_read_begin(&vm->placement);
+        online = vm->vcpus_online;
+        for (size_t i = 0; cpus && i < MAX_CPUS; i++)
+            cpus[i] = vm->cpus[i];
+    } while (seq_read_retry(&vm->placement, seq));
+
+    return online;
+}
+
+/* vm_placement_pcpus - Reads the physical CPUs of the VM's online vCPUs
+ *  @vm : VM in question
+ *
+ *  @return : bitmap of physical CPUs, indexed by cpu_index()
+ */
+uint64_t
+vm_placement_pcpus(struct vm *vm)
+{
+    uint64_t pcpus;     /* bitmap of physical CPUs    */
+    uint32_t seq;       /* placement sequence number  */
+
+    do {
+        seq   = seq_read_begin(&vm->placement);
+        pcpus = vm->pcpus_online;
+    } while (seq_read_retry(&vm->placement, seq));
+
+    return pcpus;
+}
+
+/* vm_set_vcpu_online - Publishes a vCPU power state change
+ *  @vm         : VM in question
+ *  @vcpu_index : index of the vCPU in the VM
+ *  @online     : true if the vCPU has been turned on; false otherwise
+ */
+void
+vm_set_vcpu_online(struct vm *vm, uint16_t vcpu_index, bool online)
+{
+    struct cpu *cpu;    /* physical CPU of the vCPU */
+
+    CHECK(vcpu_index < vm->vcpu_count);
+
+    cpu = cpu_find(vm->cpus[vcpu_index]);
+    CHECK(cpu != NULL);
+
+    seq_write_lock(&vm->placement);
+    if (online) {
+        vm->vcpus_online |= UINT64_C(1) << vcpu_index;
+        vm->pcpus_online |= UINT64_C(1) << cpu_index(cpu);
+    } else {
+        vm->vcpus_online &= ~(UINT64_C(1) << vcpu_index);
+        vm->pcpus_online &= ~(UINT64_C(1) << cpu_index(cpu));
+    }
+    seq_write_unlock(&vm->placement);
+}
+
+/* vm_intid_owner_set - Moves an interrupt between VMs' owned_intids
+ *  @old_vm : VM that owned the interrupt so far (may be NULL)
+ *  @vm     : VM that owns the interrupt from now on (may be NULL)
+ *  @intid  : interrupt ID
+ */
+void
+vm_intid_owner_set(struct vm *old_vm, struct vm *vm, uint32_t intid)
+{
+    uint32_t bit = 1u << (intid % 32);  /* bit of the INTID in its word */
+
+    CHECK(intid < VM_MAX_INTIDS);
+
+    if (old_vm != NULL)
+        old_vm->owned_intids[intid / 32] &= ~bit;
+    if (vm != NULL)
+        vm->owned_intids[intid / 32] |= bit;
+}
+
+/* vm_intid_owned_next - Finds the next interrupt owned by a VM
+ *  @vm   : VM in question
+ *  @from : first INTID to consider
+ *
+ *  @return : lowest owned INTID >= from; VM_MAX_INTIDS if there is none
+ */
+uint32_t
+vm_intid_owned_next(const struct vm *vm, uint32_t from)
+{
+    uint32_t i;     /* word of owned_intids being scanned        */
+    uint32_t bits;  /* owned INTIDs of that word, from `from` on */
+
+    if (from >= VM_MAX_INTIDS)
+        return VM_MAX_INTIDS;
+
+    i    = from / 32;
+    bits = vm->owned_intids[i] & (UINT32_MAX << (from % 32));
+    while (!bits) {
+        if (++i == VM_MAX_INTIDS / 32)
+            return VM_MAX_INTIDS;
+        bits = vm->owned_intids[i];
+    }
+
+    return i * 32 + ctz(bits);
+}
+
 /**
  * Find VM which belongs to the current CPU.
  * We check in the PSCI interface that VMs can only issue calls to CPUs assigned to them.
  */
 struct vm *vm_find_from_cpu(struct cpu *cpu)
 {
-	struct vm *vm_loop = NULL;
-	struct vm *vm = NULL;
-
 	if (cpu->id == 0x0) {
-		vm = vm_get_first_boot();
-	} else {
-		for (int i = 0; i < vm_get_count(); i++) {
-			vm_loop = vm_find_index(i);
-
-			for (int a = 0; a < vm_loop->vcpu_count; a++) {
-				if (vm_loop->cpus[a] == cpu->id) {
-					vm = vm_loop;
-					return vm;
-				}
-			}
-		}
+		return vm_get_first_boot();
 	}
-	return vm;
+
+	return cpu->vm;
 }
 
 /* vm_local_cpu_index - Translates physical CPU to VM's vCPU index
@@ -231,24 +343,14 @@ struct vm *vm_find_from_cpu(struct cpu *cpu)
  *
  *  @return : vCPU index on success; (uint16_t) -1 if not assigned to any VM
  *
- * TODO: This replaces Emmanuel's old function. Since we know the VM every time,
- *       do we really need to iterate over the entire VM list?
+ * The assignment is recorded in the CPU descriptor by vm_init().
  */
 uint16_t
 vm_local_cpu_index(struct cpu *cpu)
 {
-    struct vm *vm;
-
-    for (size_t i = 0; i < vm_get_count(); i++) {
-        vm = vm_find_index(i);
-        RET(!vm, -1, "Unable to get reference to VM %u\n", i);
-
-        for (size_t j = 0; j < vm->vcpu_count; j++)
-            if (vm->cpus[j] == cpu->id)
-                return j;
-    }
+    RET(!cpu->vm, -1, "CPU %#x not assigned to any VM\n", cpu->id);
 
-    return -1;
+    return cpu->vcpu_index;
 }
 
 /**
@@ -150,4 +150,134 @@ TEST_F(vm, vm_boot_order)
 		EXPECT_EQ((*it)->id, vm_cur->id);
 	}
 }
+
+/**
+ * The VM and vCPU index of a physical CPU are looked up through its
+ * descriptor, except that CPU 0 always belongs to the first VM to boot.
+ * The VM is created in the last VM slot without counting it, so the test
+ * neither depends on nor uses up the VMs of the other tests. SetUp() leaves
+ * every CPU unassigned.
+ */
+TEST_F(vm, vm_find_from_cpu)
+{
+	struct_vm *vm_cur;
+	struct cpu *c;
+
+	vm_cur = vm_init(PG_VM_ID_OFFSET + MAX_VMS - 1, 2, 2, &cpus[2],
+			 &ppool);
+	ASSERT_TRUE(vm_cur != NULL);
+
+	for (uint16_t i = 0; i < 2; i++) {
+		c = cpu_find(cpus[2 + i]);
+		ASSERT_TRUE(c != NULL);
+		EXPECT_EQ(vm_find_from_cpu(c), vm_cur);
+		EXPECT_EQ(vm_local_cpu_index(c), i);
+	}
+
+	/* Unassigned CPU. */
+	c = cpu_find(cpus[1]);
+	EXPECT_TRUE(vm_find_from_cpu(c) == NULL);
+	EXPECT_EQ(vm_local_cpu_index(c), (uint16_t)-1);
+
+	/* CPU 0 is not assigned here either, but still has a VM. */
+	c = cpu_find(cpus[0]);
+	EXPECT_EQ(vm_find_from_cpu(c), vm_get_first_boot());
+	EXPECT_EQ(vm_local_cpu_index(c), (uint16_t)-1);
+	mm_vm_fini(&vm_cur->ptable, &ppool);
+}
+
+/**
+ * An interrupt is owned by at most one VM at a time, and the owned INTIDs of
+ * a VM are visited in ascending order, across bitmap words.
+ */
+TEST(vm_intids, owner_bookkeeping)
+{
+	auto a = std::make_unique<struct_vm>();
+	auto b = std::make_unique<struct_vm>();
+	std::vector<uint32_t> owned;
+
+	EXPECT_EQ(vm_intid_owned_next(a.get(), 0), VM_MAX_INTIDS);
+
+	vm_intid_owner_set(NULL, a.get(), 32);
+	vm_intid_owner_set(NULL, a.get(), 63);
+	vm_intid_owner_set(NULL, a.get(), 64);
+	vm_intid_owner_set(NULL, a.get(), VM_MAX_INTIDS - 1);
+	for (uint32_t i = vm_intid_owned_next(a.get(), 0); i < VM_MAX_INTIDS;
+	     i = vm_intid_owned_next(a.get(), i + 1)) {
+		owned.push_back(i);
+	}
+	EXPECT_THAT(owned, ::testing::ElementsAre(32, 63, 64,
+						  VM_MAX_INTIDS - 1));
+	EXPECT_EQ(vm_intid_owned_next(a.get(), 33), 63);
+	EXPECT_EQ(vm_intid_owned_next(a.get(), VM_MAX_INTIDS), VM_MAX_INTIDS);
+
+	/* Moving an interrupt clears it in the old owner. */
+	vm_intid_owner_set(a.get(), b.get(), 63);
+	EXPECT_EQ(vm_intid_owned_next(a.get(), 33), 64);
+	EXPECT_EQ(vm_intid_owned_next(b.get(), 0), 63);
+
+	/* Disowning it leaves no owner at all. */
+	vm_intid_owner_set(b.get(), NULL, 63);
+	EXPECT_EQ(vm_intid_owned_next(b.get(), 0), VM_MAX_INTIDS);
+	EXPECT_EQ(vm_intid_owned_next(a.get(), 33), 64);
+}
+
+/**
+ * Returns the index of the cache line holding the given byte offset.
+ */
+constexpr size_t cache_line(size_t offset)
+{
+	return offset / CACHE_LINE_SIZE;
+}
+
+/**
+ * The lock and state of a vCPU, its register save area and its interrupt
+ * state are written by different pCPUs and must not share cache lines, neither
+ * with each other nor with the neighbouring vCPUs in `struct vm`.
+ */
+TEST(vm_layout, vcpu_split_by_access_pattern)
+{
+	EXPECT_EQ(alignof(struct vcpu), CACHE_LINE_SIZE);
+	EXPECT_EQ(sizeof(struct vcpu) % CACHE_LINE_SIZE, 0);
+
+	EXPECT_EQ(cache_line(offsetof(struct vcpu, lock)),
+		  cache_line(offsetof(struct vcpu, state)));
+	EXPECT_EQ(offsetof(struct vcpu, regs) % CACHE_LINE_SIZE, 0);
+	EXPECT_GT(cache_line(offsetof(struct vcpu, regs)),
+		  cache_line(offsetof(struct vcpu, vm)));
+	EXPECT_EQ(offsetof(struct vcpu, interrupts) % CACHE_LINE_SIZE, 0);
+	EXPECT_GE(offsetof(struct vcpu, interrupts),
+		  offsetof(struct vcpu, regs) + sizeof(struct arch_regs));
+
+	/* Both pending counters are on the first line of the interrupt state. */
+	EXPECT_EQ(cache_line(offsetof(struct vcpu, interrupts) +
+			     offsetof(struct interrupts,
+				      enabled_and_pending_fiq_count)),
+		  cache_line(offsetof(struct vcpu, interrupts)));
+
+	/* exceptions.S uses immediate offsets from VCPU_REGS. */
+	EXPECT_LE(offsetof(struct vcpu, regs), VCPU_REGS_OFFSET_MAX);
+}
+
+/**
+ * The VM lock and the vCPU placement seqlock have their own cache lines.
+ */
+TEST(vm_layout, vm_locks_on_own_cache_lines)
+{
+	EXPECT_EQ(offsetof(struct_vm, lock) % CACHE_LINE_SIZE, 0);
+	EXPECT_EQ(offsetof(struct_vm, vcpus),
+		  offsetof(struct_vm, lock) + CACHE_LINE_SIZE);
+	EXPECT_GT(cache_line(offsetof(struct_vm, lock)),
+		  cache_line(offsetof(struct_vm, vcpu_count)));
+	EXPECT_EQ(offsetof(struct_vm, placement) % CACHE_LINE_SIZE, 0);
+}
+
+/**
+ * Every physical CPU descriptor is on its own cache line(s).
+ */
+TEST(vm_layout, cpu_on_own_cache_line)
+{
+	EXPECT_EQ(alignof(struct cpu), CACHE_LINE_SIZE);
+	EXPECT_EQ(sizeof(struct cpu) % CACHE_LINE_SIZE, 0);
+}
 } /* namespace */
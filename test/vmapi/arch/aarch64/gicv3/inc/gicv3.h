@@ -18,6 +18,7 @@
 #define NANOS_PER_UNIT 1000000000
 
 #define SERVICE_VM1 (PG_VM_ID_OFFSET + 1)
+#define SERVICE_VM2 (PG_VM_ID_OFFSET + 2)
 
 extern alignas(PAGE_SIZE) uint8_t send_page[PAGE_SIZE];
 extern alignas(PAGE_SIZE) uint8_t recv_page[PAGE_SIZE];
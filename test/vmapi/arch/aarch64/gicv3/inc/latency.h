@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#pragma once
+
+#include "pg/types.h"
+
+/*
+ * Messages exchanged between the interrupt latency driver (latency_secondary.c)
+ * and the "latency" service. All timestamps are CNTVCT values; as the
+ * hypervisor leaves CNTVOFF_EL2 at 0, they compare directly with the CNTPCT
+ * timestamps of the VM-exit trace.
+ */
+
+/** Interrupt the service raises for itself. */
+enum latency_source {
+	LATENCY_SOURCE_TIMER,
+	LATENCY_SOURCE_SGI,
+	LATENCY_SOURCE_SPI,
+};
+
+#define LATENCY_SGI 5
+
+/**
+ * SPI assigned to the service VM in the manifests; manifest_lr.dts also
+ * delivers it through the list registers. Raised through GICD_ISPENDR.
+ */
+#define LATENCY_SPI 40
+
+/**
+ * PPI of the virtual timer. A VM with list registers takes it as such rather
+ * than as PG_VIRTUAL_TIMER_INTID.
+ */
+#define LATENCY_TIMER_PPI 27
+
+/** Number of samples the service reports per message. */
+#define LATENCY_BATCH 32
+
+/** Request sent by the primary to start a measurement. */
+struct latency_request {
+	uint32_t source;
+	/** Number of interrupts to raise. */
+	uint32_t rounds;
+	/** Counter ticks between two consecutive interrupts. */
+	uint64_t period;
+	/** Whether to wait for the interrupt in WFI rather than spinning. */
+	uint32_t wfi;
+	/**
+	 * Whether the service VM uses list registers (manifest_lr.dts), so
+	 * that it acknowledges every interrupt through ICC_IAR1_EL1.
+	 */
+	uint32_t list_registers;
+};
+
+/** Timestamps of a single interrupt as seen by the service. */
+struct latency_sample {
+	/** Interrupt raised: timer deadline or SGI/SPI register write. */
+	uint64_t raised;
+	/** First instruction of the guest's IRQ handler. */
+	uint64_t vector;
+	/**
+	 * Interrupt acknowledged, through pg_interrupt_get() or, for the SPI
+	 * and with list registers, ICC_IAR1_EL1.
+	 */
+	uint64_t acked;
+};
+
+/** Samples reported by the service; the last batch may be partial. */
+struct latency_batch {
+	uint32_t count;
+	uint32_t reserved;
+	struct latency_sample samples[LATENCY_BATCH];
+};
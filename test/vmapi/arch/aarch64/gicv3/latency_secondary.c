@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "pg/arch/irq.h"
+#include "pg/arch/vm/interrupts_gicv3.h"
+
+#include "pg/dlog.h"
+#include "pg/ffa.h"
+#include "pg/mm.h"
+#include "pg/std.h"
+
+#include "vmapi/pg/call.h"
+#include "vmapi/pg/exit_trace.h"
+
+#include "../msr.h"
+#include "gicv3.h"
+#include "latency.h"
+#include "test/hftest.h"
+#include "test/vmapi/ffa.h"
+
+/**
+ * End-to-end latency of virtual interrupts delivered to a secondary VM.
+ *
+ * The "latency" service raises virtual timer, SGI or SPI interrupts for itself
+ * at a configurable rate and timestamps when each one was raised, entered the
+ * guest's handler and was acknowledged. If the hypervisor was built with
+ * EXIT_TRACE=y, the IRQ exit that delivered the interrupt is looked up in the
+ * VM-exit trace as well, which splits the delivery into the time until
+ * irq_lower() was entered, the time spent in delegate_interrupt() and the
+ * injection, and the time from there to the guest's handler.
+ *
+ * Each stage is printed as min / p50 / p99 / max and as a histogram of
+ * log2(ticks) buckets. The *_load variants measure the same while another VM
+ * spins on a second CPU.
+ */
+
+/* Set for gicv3_lr_test, whose service VM uses list registers. */
+#ifndef LATENCY_LIST_REGISTERS
+#define LATENCY_LIST_REGISTERS 0
+#endif
+
+/* Defaults of a measurement; see latency_measure(). */
+#define LATENCY_RATE_HZ 1000
+#define LATENCY_ROUNDS 256
+
+#define LATENCY_MAX_ROUNDS 1024
+#define LATENCY_BUCKETS 16
+
+enum latency_stage {
+	LATENCY_RAISED_TO_VECTOR,
+	LATENCY_VECTOR_TO_ACK,
+	LATENCY_RAISED_TO_EL2,
+	LATENCY_EL2,
+	LATENCY_EL2_TO_VECTOR,
+	LATENCY_STAGE_COUNT,
+};
+
+static const char *const source_names[] = {
+	[LATENCY_SOURCE_TIMER] = "virtual timer",
+	[LATENCY_SOURCE_SGI] = "SGI",
+	[LATENCY_SOURCE_SPI] = "SPI",
+};
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+	"raised->handler",
+	"handler->acked",
+	"raised->irq_lower",
+	"irq_lower..eret",
+	"eret->handler",
+};
+
+static struct {
+	uint32_t count;
+	uint64_t ticks[LATENCY_MAX_ROUNDS];
+} stages[LATENCY_STAGE_COUNT];
+
+static const struct pg_exit_trace_header *trace;
+
+alignas(PAGE_SIZE) static uint8_t load_stack[PAGE_SIZE];
+
+static void stage_add(enum latency_stage stage, uint64_t ticks)
+{
+	if (stages[stage].count < LATENCY_MAX_ROUNDS) {
+		stages[stage].ticks[stages[stage].count++] = ticks;
+	}
+}
+
+/**
+ * Finds the earliest IRQ exit of the primary or the service VM between
+ * `raised` and `vector`, i.e. the one that delivered the interrupt.
+ */
+static const struct pg_exit_record *trace_find(uint64_t raised,
+					       uint64_t vector)
+{
+	const struct pg_exit_record *found = NULL;
+
+	for (uint32_t cpu = 0; cpu < trace->cpu_count; ++cpu) {
+		const struct pg_exit_trace_cpu *c =
+			(const struct pg_exit_trace_cpu *)((uintptr_t)trace +
+							   trace->cpus_offset +
+							   cpu * trace->cpu_size);
+		uint64_t head = c->head;
+		uint64_t first = head > trace->ring_entries
+					 ? head - trace->ring_entries
+					 : 0;
+
+		for (uint64_t i = first; i < head; ++i) {
+			const struct pg_exit_record *rec =
+				&c->records[i % trace->ring_entries];
+
+			if (rec->reason != PG_EXIT_IRQ ||
+			    (rec->vm_id != SERVICE_VM1 &&
+			     rec->vm_id != PG_PRIMARY_VM_ID) ||
+			    rec->entry_ticks < raised ||
+			    rec->exit_ticks > vector) {
+				continue;
+			}
+			if (found == NULL ||
+			    rec->entry_ticks < found->entry_ticks) {
+				found = rec;
+			}
+		}
+	}
+
+	return found;
+}
+
+static void batch_add(const struct latency_batch *batch)
+{
+	for (uint32_t i = 0; i < batch->count; ++i) {
+		const struct latency_sample *s = &batch->samples[i];
+		const struct pg_exit_record *rec;
+
+		EXPECT_LE(s->raised, s->vector);
+		EXPECT_LE(s->vector, s->acked);
+		stage_add(LATENCY_RAISED_TO_VECTOR, s->vector - s->raised);
+		stage_add(LATENCY_VECTOR_TO_ACK, s->acked - s->vector);
+
+		if (trace == NULL) {
+			continue;
+		}
+		rec = trace_find(s->raised, s->vector);
+		if (rec != NULL) {
+			stage_add(LATENCY_RAISED_TO_EL2,
+				  rec->entry_ticks - s->raised);
+			stage_add(LATENCY_EL2,
+				  rec->exit_ticks - rec->entry_ticks);
+			stage_add(LATENCY_EL2_TO_VECTOR,
+				  s->vector - rec->exit_ticks);
+		}
+	}
+}
+
+static void sort(uint64_t *v, uint32_t n)
+{
+	for (uint32_t i = 1; i < n; ++i) {
+		uint64_t x = v[i];
+		uint32_t j = i;
+
+		for (; j > 0 && v[j - 1] > x; --j) {
+			v[j] = v[j - 1];
+		}
+		v[j] = x;
+	}
+}
+
+static void stage_print(enum latency_stage stage)
+{
+	uint64_t *v = stages[stage].ticks;
+	uint32_t n = stages[stage].count;
+	uint32_t buckets[LATENCY_BUCKETS] = {0};
+
+	if (n == 0) {
+		return;
+	}
+
+	sort(v, n);
+	for (uint32_t i = 0; i < n; ++i) {
+		uint32_t b = 0;
+
+		while (b < LATENCY_BUCKETS - 1 && (v[i] >> b) != 0) {
+			++b;
+		}
+		buckets[b]++;
+	}
+
+	dlog("  %-18s %5u %8u %8u %8u %8u ", stage_names[stage], n, v[0],
+	     v[(n - 1) * 50 / 100], v[(n - 1) * 99 / 100], v[n - 1]);
+	for (uint32_t b = 0; b < LATENCY_BUCKETS; ++b) {
+		dlog(" %u", buckets[b]);
+	}
+	dlog("\n");
+
+	EXPECT_LE(v[0], v[(n - 1) * 50 / 100]);
+	EXPECT_LE(v[(n - 1) * 99 / 100], v[n - 1]);
+}
+
+/**
+ * Has the service raise `rounds` interrupts from `source`, `rate_hz` per
+ * second, and prints the latency of each stage in counter ticks.
+ */
+static void latency_measure(enum latency_source source, uint32_t rate_hz,
+			    uint32_t rounds, bool wfi)
+{
+	struct latency_request req = {
+		.source = source,
+		.rounds = rounds,
+		.period = read_msr(cntfrq_el0) / rate_hz,
+		.wfi = wfi,
+		.list_registers = LATENCY_LIST_REGISTERS,
+	};
+	uint32_t received = 0;
+	struct ffa_value run_res;
+
+	ASSERT_LE(rounds, LATENCY_MAX_ROUNDS);
+	memset_s(stages, sizeof(stages), 0, sizeof(stages));
+
+	/* Let the secondary get started and wait for our request. */
+	run_res = ffa_run(SERVICE_VM1, 0);
+	EXPECT_EQ(run_res.func, FFA_MSG_WAIT_32);
+
+	memcpy_s(send_buffer, FFA_MSG_PAYLOAD_MAX, &req, sizeof(req));
+	EXPECT_EQ(ffa_msg_send(PG_PRIMARY_VM_ID, SERVICE_VM1, sizeof(req), 0)
+			  .func,
+		  FFA_SUCCESS_32);
+
+	/*
+	 * The service runs until it reports a batch; anything else, e.g. the
+	 * primary being interrupted, only means running it again.
+	 */
+	while (received < rounds) {
+		run_res = ffa_run(SERVICE_VM1, 0);
+		if (run_res.func == FFA_MSG_WAIT_32) {
+			FAIL("Service stopped after %u of %u samples\n",
+			     received, rounds);
+		}
+		if (run_res.func != FFA_MSG_SEND_32) {
+			continue;
+		}
+
+		ASSERT_EQ(ffa_msg_send_size(run_res),
+			  sizeof(struct latency_batch));
+		batch_add((const struct latency_batch *)recv_buffer);
+		received += ((const struct latency_batch *)recv_buffer)->count;
+		EXPECT_EQ(ffa_rx_release().func, FFA_SUCCESS_32);
+	}
+	EXPECT_EQ(received, rounds);
+
+	dlog("%s latency, %u Hz%s, in ticks of a %u Hz counter:\n",
+	     source_names[source], rate_hz,
+	     wfi ? " from WFI" : "", read_msr(cntfrq_el0));
+	dlog("  %-18s %5s %8s %8s %8s %8s  log2(ticks) buckets\n", "stage",
+	     "n", "min", "p50", "p99", "max");
+	for (uint32_t s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+		stage_print(s);
+	}
+}
+
+static void latency_setup(void)
+{
+	int64_t ipa;
+
+	system_setup();
+
+	EXPECT_EQ(ffa_rxtx_map(send_page_addr, recv_page_addr).func,
+		  FFA_SUCCESS_32);
+	SERVICE_SELECT(SERVICE_VM1, "latency", send_buffer);
+
+	interrupt_enable(VIRTUAL_TIMER_IRQ, true);
+	interrupt_set_edge_triggered(VIRTUAL_TIMER_IRQ, true);
+	interrupt_set_priority_mask(0xff);
+	arch_irq_enable();
+
+	/* The stages within the hypervisor need EXIT_TRACE=y. */
+	ipa = pg_exit_trace_map();
+	if (ipa == -1) {
+		dlog("No exit trace, only measuring from the guest\n");
+		trace = NULL;
+		return;
+	}
+	hftest_mm_identity_map((void *)ipa, PAGE_SIZE, MM_MODE_R);
+	trace = (const struct pg_exit_trace_header *)ipa;
+	hftest_mm_identity_map((void *)ipa, trace->size, MM_MODE_R);
+}
+
+/**
+ * Keeps the busy service VM running on this CPU. It never yields, so this
+ * only returns to the loop if the CPU is interrupted.
+ */
+static void load_cpu_entry(uintptr_t arg)
+{
+	(void)arg;
+
+	for (;;) {
+		ffa_run(SERVICE_VM2, 0);
+	}
+}
+
+SET_UP(latency_secondary)
+{
+	latency_setup();
+}
+
+TEAR_DOWN(latency_secondary)
+{
+	EXPECT_FFA_ERROR(ffa_rx_release(), FFA_DENIED);
+}
+
+SET_UP(latency_secondary_load)
+{
+	const char message[] = "loop";
+	struct ffa_value run_res;
+
+	latency_setup();
+
+	/* Start the busy service and have it spin on the second CPU. */
+	SERVICE_SELECT(SERVICE_VM2, "busy", send_buffer);
+	run_res = ffa_run(SERVICE_VM2, 0);
+	EXPECT_EQ(run_res.func, FFA_MSG_WAIT_32);
+
+	memcpy_s(send_buffer, FFA_MSG_PAYLOAD_MAX, message, sizeof(message));
+	EXPECT_EQ(
+		ffa_msg_send(PG_PRIMARY_VM_ID, SERVICE_VM2, sizeof(message), 0)
+			.func,
+		FFA_SUCCESS_32);
+	EXPECT_EQ(hftest_cpu_start(hftest_get_cpu_id(1), load_stack,
+				   sizeof(load_stack), load_cpu_entry, 0),
+		  true);
+}
+
+TEAR_DOWN(latency_secondary_load)
+{
+	EXPECT_FFA_ERROR(ffa_rx_release(), FFA_DENIED);
+}
+
+TEST(latency_secondary, timer)
+{
+	latency_measure(LATENCY_SOURCE_TIMER, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			false);
+}
+
+TEST(latency_secondary, timer_wfi)
+{
+	latency_measure(LATENCY_SOURCE_TIMER, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			true);
+}
+
+TEST(latency_secondary, sgi)
+{
+	latency_measure(LATENCY_SOURCE_SGI, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			false);
+}
+
+/**
+ * The service's own SPI. Run from gicv3_test and gicv3_lr_test, this compares
+ * the delivery of the same SPI without and with list registers, as the timer
+ * cases do for the virtual timer.
+ */
+TEST(latency_secondary, spi)
+{
+	latency_measure(LATENCY_SOURCE_SPI, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			false);
+}
+
+TEST(latency_secondary, sgi_high_rate)
+{
+	latency_measure(LATENCY_SOURCE_SGI, 10 * LATENCY_RATE_HZ,
+			LATENCY_MAX_ROUNDS, false);
+}
+
+TEST(latency_secondary_load, timer)
+{
+	latency_measure(LATENCY_SOURCE_TIMER, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			false);
+}
+
+TEST(latency_secondary_load, sgi)
+{
+	latency_measure(LATENCY_SOURCE_SGI, LATENCY_RATE_HZ, LATENCY_ROUNDS,
+			false);
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2023 SANCTUARY Systems GmbH
+ *
+ * This file is free software: you may copy, redistribute and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For a commercial license, please contact SANCTUARY Systems GmbH
+ * directly at info@sanctuary.dev
+ */
+
+
+#include "pg/arch/vm/timer.h"
+
+#include "pg/arch/irq.h"
+#include "pg/arch/vm/interrupts.h"
+#include "pg/arch/vm/interrupts_gicv3.h"
+
+#include "pg/ffa.h"
+#include "pg/std.h"
+
+#include "vmapi/pg/call.h"
+
+#include "../msr.h"
+#include "common.h"
+#include "latency.h"
+#include "test/hftest.h"
+
+/*
+ * Secondary VM that raises interrupts for itself at the rate requested by the
+ * primary and reports when each of them reached its handler, in batches of
+ * LATENCY_BATCH samples. See latency_secondary.c for the driver.
+ */
+
+static volatile uint64_t vector_ticks;
+static volatile uint64_t acked_ticks;
+static volatile uint32_t acked_intid;
+
+/*
+ * Whether interrupts are acknowledged through the GIC CPU interface, as the
+ * SPI is: a VM with list registers acknowledges it from the virtual CPU
+ * interface, any other VM from the physical one. A VM with list registers
+ * acknowledges all its interrupts this way.
+ */
+static bool ack_icc;
+
+static void irq_latency(void)
+{
+	uint64_t vector = read_msr(cntvct_el0);
+	uint32_t intid;
+
+	if (ack_icc) {
+		intid = interrupt_get_and_acknowledge();
+		acked_ticks = read_msr(cntvct_el0);
+		vector_ticks = vector;
+
+		/* The timer's PPI is level-sensitive; lower it before the EOI. */
+		if (intid == LATENCY_TIMER_PPI) {
+			timer_stop();
+		}
+		interrupt_end(intid);
+		acked_intid = intid;
+		return;
+	}
+
+	intid = pg_interrupt_get();
+	acked_ticks = read_msr(cntvct_el0);
+	vector_ticks = vector;
+
+	if (intid == PG_VIRTUAL_TIMER_INTID) {
+		timer_stop();
+	}
+
+	acked_intid = intid;
+}
+
+/**
+ * Waits for the interrupt raised last to be handled. With `wfi` the vCPU idles
+ * with interrupts masked, so that the wake-up is part of the measurement.
+ */
+static void wait_for(uint32_t intid, bool wfi)
+{
+	if (!wfi) {
+		while (acked_intid != intid) {
+		}
+		return;
+	}
+
+	arch_irq_disable();
+	while (acked_intid != intid) {
+		interrupt_wait();
+		arch_irq_enable();
+		arch_irq_disable();
+	}
+	arch_irq_enable();
+}
+
+static void measure(const struct latency_request *req)
+{
+	uint64_t mpidr = read_msr(mpidr_el1);
+	uint32_t intid = req->source == LATENCY_SOURCE_SGI   ? LATENCY_SGI
+			 : req->source == LATENCY_SOURCE_SPI ? LATENCY_SPI
+			 : req->list_registers		     ? LATENCY_TIMER_PPI
+							     : PG_VIRTUAL_TIMER_INTID;
+	uint64_t next = read_msr(cntvct_el0);
+	struct latency_batch batch = {0};
+
+	ack_icc = req->source == LATENCY_SOURCE_SPI || req->list_registers;
+	if (req->list_registers) {
+		/* The timer reaches the guest as a PPI it has to enable. */
+		interrupt_set_priority(LATENCY_TIMER_PPI, 0x80);
+		interrupt_enable(LATENCY_TIMER_PPI, true);
+	}
+
+	for (uint32_t i = 0; i < req->rounds; ++i) {
+		struct latency_sample *sample = &batch.samples[batch.count];
+
+		acked_intid = PG_INVALID_INTID;
+
+		if (req->source == LATENCY_SOURCE_SGI) {
+			next += req->period;
+			while (read_msr(cntvct_el0) < next) {
+			}
+			sample->raised = read_msr(cntvct_el0);
+			interrupt_send_sgi(LATENCY_SGI, false, (mpidr >> 32) & 0xff,
+					   (mpidr >> 16) & 0xff,
+					   (mpidr >> 8) & 0xff,
+					   1U << (mpidr & 0xf));
+		} else if (req->source == LATENCY_SOURCE_SPI) {
+			/*
+			 * The next SPI is only signalled once the guest's EOI
+			 * has deactivated the previous one, so a delivery path
+			 * that leaves it active stalls the measurement.
+			 */
+			next += req->period;
+			while (read_msr(cntvct_el0) < next) {
+			}
+			sample->raised = read_msr(cntvct_el0);
+			io_write32_array(GICD_ISPENDR, LATENCY_SPI / 32,
+					 1U << (LATENCY_SPI % 32));
+		} else {
+			timer_set(req->period);
+			timer_start();
+			sample->raised = read_msr(cntv_cval_el0);
+		}
+
+		wait_for(intid, req->wfi);
+		sample->vector = vector_ticks;
+		sample->acked = acked_ticks;
+
+		if (++batch.count == LATENCY_BATCH || i + 1 == req->rounds) {
+			memcpy_s(SERVICE_SEND_BUFFER(), FFA_MSG_PAYLOAD_MAX,
+				 &batch, sizeof(batch));
+			EXPECT_EQ(ffa_msg_send(pg_vm_get_id(), PG_PRIMARY_VM_ID,
+					       sizeof(batch), 0)
+					  .func,
+				  FFA_SUCCESS_32);
+			batch.count = 0;
+		}
+	}
+}
+
+TEST_SERVICE(latency)
+{
+	exception_setup(irq_latency, NULL);
+	pg_interrupt_enable(PG_VIRTUAL_TIMER_INTID, true, INTERRUPT_TYPE_IRQ);
+	pg_interrupt_enable(LATENCY_SGI, true, INTERRUPT_TYPE_IRQ);
+	interrupt_set_priority_mask(0xff);
+	interrupt_set_priority(LATENCY_SPI, 0x80);
+	interrupt_enable(LATENCY_SPI, true);
+	arch_irq_enable();
+
+	for (;;) {
+		struct latency_request req;
+		struct ffa_value ret = mailbox_receive_retry();
+
+		if (ffa_sender(ret) != PG_PRIMARY_VM_ID ||
+		    ffa_msg_send_size(ret) != sizeof(req)) {
+			FAIL("Got unexpected message from VM %d, size %d.\n",
+			     ffa_sender(ret), ffa_msg_send_size(ret));
+		}
+
+		memcpy_s(&req, sizeof(req), SERVICE_RECV_BUFFER(), sizeof(req));
+		EXPECT_EQ(ffa_rx_release().func, FFA_SUCCESS_32);
+
+		measure(&req);
+	}
+}
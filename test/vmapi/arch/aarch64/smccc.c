@@ -11,6 +11,7 @@
 #include "vmapi/pg/call.h"
 #include "vmapi/pg/ffa.h"
 
+#include "msr.h"
 #include "smc.h"
 #include "test/hftest.h"
 
@@ -95,3 +96,49 @@ TEST(smccc, ffa_features_smc)
 	EXPECT_EQ(ret.arg6, 0);
 	EXPECT_EQ(ret.arg7, 0);
 }
+
+/**
+ * Reports the round trip of hypercalls that take the fast path next to one
+ * that always takes the generic path. The numbers are only logged as they
+ * depend on the platform, but all calls must still return the expected values.
+ *
+ * For before/after numbers of the same calls, run this test once more against
+ * a hypervisor built with HVC_FAST_PATH=n, which sends them down the generic
+ * path as well.
+ */
+TEST(smccc, hvc_fast_path_round_trip)
+{
+	const uint64_t iterations = 1000;
+	uint64_t get_ticks;
+	uint64_t version_ticks;
+	uint64_t generic_ticks;
+	uint64_t start;
+	uint64_t i;
+
+	start = read_msr(cntvct_el0);
+	for (i = 0; i < iterations; ++i) {
+		EXPECT_EQ(pg_interrupt_get(), PG_INVALID_INTID);
+	}
+	get_ticks = read_msr(cntvct_el0) - start;
+
+	start = read_msr(cntvct_el0);
+	for (i = 0; i < iterations; ++i) {
+		EXPECT_EQ(ffa_version(FFA_VERSION_COMPILED),
+			  FFA_VERSION_COMPILED);
+	}
+	version_ticks = read_msr(cntvct_el0) - start;
+
+	/* Unimplemented calls are rejected on the generic path. */
+	start = read_msr(cntvct_el0);
+	for (i = 0; i < iterations; ++i) {
+		EXPECT_EQ(hvc(PG_MAILBOX_WRITABLE_GET, 0, 0, 0, 0, 0, 0, 0)
+				  .func,
+			  (uint64_t)SMCCC_ERROR_UNKNOWN);
+	}
+	generic_ticks = read_msr(cntvct_el0) - start;
+
+	HFTEST_LOG("%u hypercalls at %u Hz: pg_interrupt_get %u ticks, "
+		   "FFA_VERSION %u ticks, unknown call %u ticks",
+		   iterations, read_msr(cntfrq_el0), get_ticks, version_ticks,
+		   generic_ticks);
+}